@@ -0,0 +1,117 @@
+
+// This file is a part of MRNIU/fdt-parser
+// (https://github.com/MRNIU/fdt-parser).
+//
+// fdt_mmap.cpp for MRNIU/fdt-parser.
+
+#include "fdt_mmap.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FDT_PARSER {
+
+namespace {
+
+/**
+ * @brief 提示内核即将访问区域
+ * @param  _base           映射地址
+ * @param  _off            区域偏移
+ * @param  _size           区域长度
+ * @note madvise 要求起始地址按页对齐
+ */
+void will_need(uintptr_t _base, size_t _off, size_t _size) {
+  auto page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  auto start = (_base + _off) & ~(page - 1);
+  madvise((void*)start, _base + _off + _size - start, MADV_WILLNEED);
+}
+
+}  // namespace
+
+fdt_mmap::fdt_mmap(const char* _path)
+    : map_addr(nullptr), map_len(0), map_status(STATUS_OPEN_FAILED) {
+  auto fd = open(_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return;
+  }
+  if ((size_t)st.st_size < sizeof(fdt_index::fdt_header_t)) {
+    close(fd);
+    map_status = STATUS_BAD_MAGIC;
+    return;
+  }
+  auto addr =
+      mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // 映射建立后不再需要文件描述符
+  close(fd);
+  if (addr == MAP_FAILED) {
+    map_status = STATUS_MMAP_FAILED;
+    return;
+  }
+  map_addr = addr;
+  map_len = (size_t)st.st_size;
+  map_status = check();
+  if (map_status != STATUS_OK) {
+    unmap();
+    return;
+  }
+  // 解析时按顺序访问数据区，并查找字符区中的属性名
+  madvise(map_addr, map_len, MADV_SEQUENTIAL);
+  auto header = (const fdt_index::fdt_header_t*)map_addr;
+  will_need((uintptr_t)map_addr, fdt_parser_be32toh(header->off_dt_struct),
+            fdt_parser_be32toh(header->size_dt_struct));
+  will_need((uintptr_t)map_addr, fdt_parser_be32toh(header->off_dt_strings),
+            fdt_parser_be32toh(header->size_dt_strings));
+}
+
+fdt_mmap::fdt_mmap(fdt_mmap&& _fdt_mmap)
+    : map_addr(_fdt_mmap.map_addr),
+      map_len(_fdt_mmap.map_len),
+      map_status(_fdt_mmap.map_status) {
+  _fdt_mmap.map_addr = nullptr;
+  _fdt_mmap.map_len = 0;
+  _fdt_mmap.map_status = STATUS_OPEN_FAILED;
+}
+
+auto fdt_mmap::operator=(fdt_mmap&& _fdt_mmap) -> fdt_mmap& {
+  if (this != &_fdt_mmap) {
+    unmap();
+    map_addr = _fdt_mmap.map_addr;
+    map_len = _fdt_mmap.map_len;
+    map_status = _fdt_mmap.map_status;
+    _fdt_mmap.map_addr = nullptr;
+    _fdt_mmap.map_len = 0;
+    _fdt_mmap.map_status = STATUS_OPEN_FAILED;
+  }
+  return *this;
+}
+
+fdt_mmap::~fdt_mmap() { unmap(); }
+
+fdt_mmap::status_t fdt_mmap::check(void) const {
+  // 与解析器使用相同的检查，失败时只区分是否是 dtb
+  auto header = (const fdt_index::fdt_header_t*)map_addr;
+  if (!fdt_index::header_ok(header, map_len) ||
+      !fdt_index::reserved_ok((uintptr_t)map_addr)) {
+    return fdt_parser_be32toh(header->magic) == fdt_index::FDT_MAGIC
+               ? STATUS_BAD_HEADER
+               : STATUS_BAD_MAGIC;
+  }
+  return STATUS_OK;
+}
+
+void fdt_mmap::unmap(void) {
+  if (map_addr != nullptr) {
+    munmap(map_addr, map_len);
+    map_addr = nullptr;
+    map_len = 0;
+  }
+}
+
+}  // namespace FDT_PARSER
@@ -0,0 +1,1202 @@
+
+// This file is a part of MRNIU/fdt-parser
+// (https://github.com/MRNIU/fdt-parser).
+//
+// fdt_decompressor.hpp for MRNIU/fdt-parser.
+
+#ifndef FDT_PARSER_SRC_INCLUDE_FDT_DECOMPRESSOR_H
+#define FDT_PARSER_SRC_INCLUDE_FDT_DECOMPRESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fdt_parser.hpp"
+
+namespace FDT_PARSER {
+
+/**
+ * @brief 解压 gzip 或 lz4 frame 格式压缩的 dtb
+ * @note 不依赖外部库，不使用堆，可以在 freestanding 环境中使用
+ * @note 输出直接写入调用者提供的缓冲区，每写入 CHUNK_SIZE 字节通知一次，
+ * load() 在通知时将新数据交给 stream_feed()，趁数据还在缓存中建立索引
+ * @see RFC 1951, RFC 1952, lz4_Frame_format.md, lz4_Block_format.md
+ */
+class fdt_decompressor {
+ public:
+  /**
+   * @brief 输入格式
+   */
+  enum format_t : uint8_t {
+    /// 无法识别
+    FORMAT_UNKNOWN = 0,
+    /// 未压缩的 dtb
+    FORMAT_FDT,
+    /// gzip
+    FORMAT_GZIP,
+    /// lz4 frame
+    FORMAT_LZ4,
+  };
+
+  /**
+   * @brief 解压结果
+   */
+  enum status_t : uint8_t {
+    /// 成功
+    STATUS_OK = 0,
+    /// 无法识别的格式
+    STATUS_UNKNOWN_FORMAT,
+    /// 压缩数据错误或不完整
+    STATUS_CORRUPT,
+    /// 校验和错误
+    STATUS_CHECKSUM,
+    /// 输出缓冲区不足
+    STATUS_NO_SPACE,
+    /// 不支持的选项，如 lz4 的预置字典
+    STATUS_UNSUPPORTED,
+    /// 进度回调返回 false
+    STATUS_ABORTED,
+    /// 解压后的 dtb 格式错误或超出索引容量
+    STATUS_BAD_DTB,
+  };
+
+  /// 每写入多少字节调用一次进度回调
+  static constexpr const size_t CHUNK_SIZE = 1024;
+
+  /**
+   * @brief 进度回调
+   * @param  _produced       已经写入输出缓冲区的总长度
+   * @param  _ctx            调用者提供的参数
+   * @return true            继续
+   * @return false           停止解压
+   */
+  typedef bool (*progress_t)(size_t _produced, void* _ctx);
+
+ private:
+  /// 查表解码的编码长度
+  static constexpr const size_t FAST_BITS = 9;
+  /// 字面量/长度符号数
+  static constexpr const size_t LITLEN_COUNT = 288;
+  /// 距离符号数
+  static constexpr const size_t DIST_COUNT = 32;
+
+  /**
+   * @brief 范式 huffman 解码表
+   * @note 不超过 FAST_BITS 位的编码直接查表，其余按长度逐级比较
+   */
+  struct huffman_t {
+    /// (编码长度 << 9) | 符号，0 表示需要逐级比较
+    uint16_t fast[1 << FAST_BITS];
+    /// 各长度的第一个编码
+    uint16_t first_code[16];
+    /// 各长度的第一个符号在 symbols 中的下标
+    uint16_t first_symbol[16];
+    /// 各长度的最大编码 + 1，左对齐到 16 位
+    uint32_t max_code[17];
+    /// 按编码排序的符号长度
+    uint8_t lengths[LITLEN_COUNT];
+    /// 按编码排序的符号
+    uint16_t symbols[LITLEN_COUNT];
+  };
+
+  /**
+   * @brief 增量计算的 xxHash32
+   */
+  struct xxh32_t {
+    /// 四路累加器
+    uint32_t acc[4];
+    /// 不足 16 字节的剩余数据
+    uint8_t buf[16];
+    /// buf 中的字节数
+    size_t buf_len;
+    /// 总长度
+    uint64_t total;
+  };
+
+  /// @see xxhash.h
+  static constexpr const uint32_t XXH_PRIME1 = 0x9E3779B1U;
+  static constexpr const uint32_t XXH_PRIME2 = 0x85EBCA77U;
+  static constexpr const uint32_t XXH_PRIME3 = 0xC2B2AE3DU;
+  static constexpr const uint32_t XXH_PRIME4 = 0x27D4EB2FU;
+  static constexpr const uint32_t XXH_PRIME5 = 0x165667B1U;
+
+  /// lz4 frame 魔数
+  static constexpr const uint32_t LZ4_MAGIC = 0x184D2204;
+  /// lz4 可跳过 frame 的魔数，低 4 位任意
+  static constexpr const uint32_t LZ4_SKIPPABLE_MAGIC = 0x184D2A50;
+
+  /**
+   * @brief crc32 查找表
+   * @note table[k][i] 为字节 i 之后再跟 k 个 0 字节的 crc，
+   * 每次可以处理 4 字节 (slicing-by-4)
+   */
+  struct crc32_table_t {
+    uint32_t table[4][256];
+    constexpr crc32_table_t() : table() {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (size_t k = 0; k < 8; k++) {
+          crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320U : 0);
+        }
+        table[0][i] = crc;
+      }
+      for (size_t k = 1; k < 4; k++) {
+        for (size_t i = 0; i < 256; i++) {
+          auto prev = table[k - 1][i];
+          table[k][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+        }
+      }
+    }
+  };
+
+  /// crc32 查找表，编译期生成，定义在类外
+  static const crc32_table_t CRC32;
+
+  /// 长度符号 257..285 的基数与额外位数
+  static constexpr const uint16_t LENGTH_BASE[29] = {
+      3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static constexpr const uint8_t LENGTH_EXTRA[29] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  /// 距离符号 0..29 的基数与额外位数
+  static constexpr const uint16_t DIST_BASE[30] = {
+      1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+      33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+  static constexpr const uint8_t DIST_EXTRA[30] = {
+      0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+  /// 编码长度的编码长度的排列顺序
+  static constexpr const uint8_t CODE_LENGTH_ORDER[19] = {
+      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+  /// 输入
+  const uint8_t* src;
+  /// 输入长度
+  size_t src_len;
+  /// 下一个要读取的输入字节，可能超出 src_len，结束时检查
+  size_t in_pos;
+  /// 未使用的输入位，低位在前
+  uint64_t bit_buf;
+  /// bit_buf 中的位数
+  size_t bit_count;
+  /// 输出缓冲区
+  uint8_t* dst;
+  /// 输出缓冲区长度
+  size_t dst_cap;
+  /// 已经写入的长度
+  size_t out_pos;
+  /// 上一次通知时的 out_pos
+  size_t reported;
+  /// 进度回调
+  progress_t progress;
+  /// 回调参数
+  void* ctx;
+  /// 已通知部分的 crc32，gzip 使用
+  uint32_t crc;
+  /// 是否计算 crc32
+  bool check_crc;
+  /// 字面量/长度与距离解码表
+  huffman_t litlen;
+  huffman_t dist;
+
+  /**
+   * @brief 读取小端序的 16 位整数
+   * @param  _p              地址
+   * @return uint16_t        值
+   */
+  static uint16_t read_le16(const uint8_t* _p) {
+    return (uint16_t)(_p[0] | (_p[1] << 8));
+  }
+
+  /**
+   * @brief 读取小端序的 32 位整数
+   * @param  _p              地址
+   * @return uint32_t        值
+   */
+  static uint32_t read_le32(const uint8_t* _p) {
+    return (uint32_t)_p[0] | ((uint32_t)_p[1] << 8) |
+           ((uint32_t)_p[2] << 16) | ((uint32_t)_p[3] << 24);
+  }
+
+  /**
+   * @brief 循环左移
+   * @param  _x              值
+   * @param  _r              位数
+   * @return uint32_t        结果
+   */
+  static uint32_t rotl32(uint32_t _x, size_t _r) {
+    return (_x << _r) | (_x >> (32 - _r));
+  }
+
+  /**
+   * @brief 复制内存，不能重叠
+   * @param  _dst            目的地址
+   * @param  _src            源地址
+   * @param  _len            长度
+   * @note 写入 uint8_t 会被认为可能修改成员，循环中只使用局部变量
+   */
+  static void copy_bytes(uint8_t* _dst, const uint8_t* _src, size_t _len) {
+    for (size_t i = 0; i < _len; i++) {
+      _dst[i] = _src[i];
+    }
+    return;
+  }
+
+  /**
+   * @brief 复制已经输出的数据，可以重叠
+   * @param  _dst            目的地址
+   * @param  _distance       源地址在 _dst 之前的距离
+   * @param  _len            长度
+   * @note 重叠时逐字节复制，结果是重复的模式
+   */
+  static void copy_match(uint8_t* _dst, size_t _distance, size_t _len) {
+    const uint8_t* from = _dst - _distance;
+    if (_distance >= _len) {
+      copy_bytes(_dst, from, _len);
+      return;
+    }
+    for (size_t i = 0; i < _len; i++) {
+      _dst[i] = from[i];
+    }
+    return;
+  }
+
+  /**
+   * @brief 更新 crc32
+   * @param  _crc            之前的结果，初始为 0
+   * @param  _data           数据
+   * @param  _len            数据长度
+   * @return uint32_t        新的结果
+   */
+  static uint32_t crc32_update(uint32_t _crc, const uint8_t* _data,
+                               size_t _len) {
+    auto& t = CRC32.table;
+    _crc = ~_crc;
+    for (; _len >= 4; _data += 4, _len -= 4) {
+      _crc ^= read_le32(_data);
+      _crc = t[3][_crc & 0xFF] ^ t[2][(_crc >> 8) & 0xFF] ^
+             t[1][(_crc >> 16) & 0xFF] ^ t[0][_crc >> 24];
+    }
+    for (size_t i = 0; i < _len; i++) {
+      _crc = t[0][(_crc ^ _data[i]) & 0xFF] ^ (_crc >> 8);
+    }
+    return ~_crc;
+  }
+
+  /**
+   * @brief xxHash32 的一轮
+   * @param  _acc            累加器
+   * @param  _input          4 字节输入
+   * @return uint32_t        新的累加器
+   */
+  static uint32_t xxh32_round(uint32_t _acc, uint32_t _input) {
+    return rotl32(_acc + _input * XXH_PRIME2, 13) * XXH_PRIME1;
+  }
+
+  /**
+   * @brief 初始化 xxHash32，种子为 0
+   * @param  _state          状态
+   */
+  static void xxh32_init(xxh32_t& _state) {
+    _state.acc[0] = XXH_PRIME1 + XXH_PRIME2;
+    _state.acc[1] = XXH_PRIME2;
+    _state.acc[2] = 0;
+    _state.acc[3] = 0 - XXH_PRIME1;
+    _state.buf_len = 0;
+    _state.total = 0;
+    return;
+  }
+
+  /**
+   * @brief 更新 xxHash32
+   * @param  _state          状态
+   * @param  _data           数据
+   * @param  _len            数据长度
+   */
+  static void xxh32_update(xxh32_t& _state, const uint8_t* _data,
+                           size_t _len) {
+    _state.total += _len;
+    // 先补齐上一次剩余的数据
+    while (_state.buf_len != 0 && _len != 0) {
+      _state.buf[_state.buf_len++] = *_data++;
+      _len--;
+      if (_state.buf_len == 16) {
+        for (size_t k = 0; k < 4; k++) {
+          _state.acc[k] =
+              xxh32_round(_state.acc[k], read_le32(_state.buf + k * 4));
+        }
+        _state.buf_len = 0;
+      }
+    }
+    for (; _len >= 16; _data += 16, _len -= 16) {
+      for (size_t k = 0; k < 4; k++) {
+        _state.acc[k] = xxh32_round(_state.acc[k], read_le32(_data + k * 4));
+      }
+    }
+    for (size_t i = 0; i < _len; i++) {
+      _state.buf[_state.buf_len++] = _data[i];
+    }
+    return;
+  }
+
+  /**
+   * @brief 计算 xxHash32 的结果
+   * @param  _state          状态
+   * @return uint32_t        哈希
+   */
+  static uint32_t xxh32_digest(const xxh32_t& _state) {
+    uint32_t h;
+    if (_state.total >= 16) {
+      h = rotl32(_state.acc[0], 1) + rotl32(_state.acc[1], 7) +
+          rotl32(_state.acc[2], 12) + rotl32(_state.acc[3], 18);
+    } else {
+      h = XXH_PRIME5;
+    }
+    h += (uint32_t)_state.total;
+    size_t i = 0;
+    for (; i + 4 <= _state.buf_len; i += 4) {
+      h = rotl32(h + read_le32(_state.buf + i) * XXH_PRIME3, 17) * XXH_PRIME4;
+    }
+    for (; i < _state.buf_len; i++) {
+      h = rotl32(h + _state.buf[i] * XXH_PRIME5, 11) * XXH_PRIME1;
+    }
+    h ^= h >> 15;
+    h *= XXH_PRIME2;
+    h ^= h >> 13;
+    h *= XXH_PRIME3;
+    h ^= h >> 16;
+    return h;
+  }
+
+  /**
+   * @brief 计算一段数据的 xxHash32
+   * @param  _data           数据
+   * @param  _len            数据长度
+   * @return uint32_t        哈希
+   */
+  static uint32_t xxh32(const uint8_t* _data, size_t _len) {
+    xxh32_t state;
+    xxh32_init(state);
+    xxh32_update(state, _data, _len);
+    return xxh32_digest(state);
+  }
+
+  /**
+   * @brief 通知新写入的数据
+   * @param  _final          是否为最后一次，此时不足 CHUNK_SIZE 也通知
+   * @return true            继续
+   * @return false           回调要求停止
+   */
+  bool report(bool _final) {
+    if (out_pos == reported || (!_final && out_pos - reported < CHUNK_SIZE)) {
+      return true;
+    }
+    if (check_crc) {
+      crc = crc32_update(crc, dst + reported, out_pos - reported);
+    }
+    reported = out_pos;
+    return progress == nullptr || progress(out_pos, ctx);
+  }
+
+  /**
+   * @brief 开始解压
+   * @param  _src            输入
+   * @param  _src_len        输入长度
+   * @param  _dst            输出缓冲区
+   * @param  _dst_cap        输出缓冲区长度
+   * @param  _progress       进度回调，可以为 nullptr
+   * @param  _ctx            回调参数
+   */
+  void reset(const void* _src, size_t _src_len, void* _dst, size_t _dst_cap,
+             progress_t _progress, void* _ctx) {
+    src = (const uint8_t*)_src;
+    src_len = _src_len;
+    in_pos = 0;
+    bit_buf = 0;
+    bit_count = 0;
+    dst = (uint8_t*)_dst;
+    dst_cap = _dst_cap;
+    out_pos = 0;
+    reported = 0;
+    progress = _progress;
+    ctx = _ctx;
+    crc = 0;
+    check_crc = false;
+    return;
+  }
+
+  /**
+   * @brief 补充 bit_buf 至至少 57 位，超出输入的部分补 0
+   */
+  void refill(void) {
+    while (bit_count <= 56) {
+      uint64_t byte = (in_pos < src_len) ? src[in_pos] : 0;
+      in_pos++;
+      bit_buf |= byte << bit_count;
+      bit_count += 8;
+    }
+    return;
+  }
+
+  /**
+   * @brief 读取 _n 位，低位在前
+   * @param  _n              位数，不超过 32
+   * @return uint32_t        值
+   */
+  uint32_t bits(size_t _n) {
+    if (bit_count < _n) {
+      refill();
+    }
+    auto res = (uint32_t)(bit_buf & ((1ULL << _n) - 1));
+    bit_buf >>= _n;
+    bit_count -= _n;
+    return res;
+  }
+
+  /**
+   * @brief 丢弃到字节边界，并将 bit_buf 中未使用的整字节还给输入
+   */
+  void align_to_byte(void) {
+    bit_buf = 0;
+    in_pos -= bit_count / 8;
+    bit_count = 0;
+    return;
+  }
+
+  /**
+   * @brief 反转低 _n 位
+   * @param  _x              值
+   * @param  _n              位数，不超过 16
+   * @return uint32_t        结果
+   */
+  static uint32_t reverse_bits(uint32_t _x, size_t _n) {
+    _x = ((_x & 0xAAAA) >> 1) | ((_x & 0x5555) << 1);
+    _x = ((_x & 0xCCCC) >> 2) | ((_x & 0x3333) << 2);
+    _x = ((_x & 0xF0F0) >> 4) | ((_x & 0x0F0F) << 4);
+    _x = ((_x & 0xFF00) >> 8) | ((_x & 0x00FF) << 8);
+    return _x >> (16 - _n);
+  }
+
+  /**
+   * @brief 根据编码长度建立解码表
+   * @param  _table          解码表
+   * @param  _lengths        各符号的编码长度
+   * @param  _count          符号数
+   * @return true            成功
+   * @return false           编码超额
+   */
+  static bool build_huffman(huffman_t& _table, const uint8_t* _lengths,
+                            size_t _count) {
+    uint16_t counts[16] = {};
+    uint16_t next_code[16];
+    for (size_t i = 0; i < (1 << FAST_BITS); i++) {
+      _table.fast[i] = 0;
+    }
+    for (size_t i = 0; i < _count; i++) {
+      counts[_lengths[i]]++;
+    }
+    counts[0] = 0;
+    uint32_t code = 0;
+    uint16_t symbol = 0;
+    for (size_t len = 1; len < 16; len++) {
+      next_code[len] = (uint16_t)code;
+      _table.first_code[len] = (uint16_t)code;
+      _table.first_symbol[len] = symbol;
+      code += counts[len];
+      if (code > (1U << len)) {
+        return false;
+      }
+      _table.max_code[len] = code << (16 - len);
+      code <<= 1;
+      symbol += counts[len];
+    }
+    _table.max_code[16] = 0x10000;
+    for (size_t i = 0; i < _count; i++) {
+      size_t len = _lengths[i];
+      if (len == 0) {
+        continue;
+      }
+      size_t idx = next_code[len] - _table.first_code[len] +
+                   _table.first_symbol[len];
+      _table.lengths[idx] = (uint8_t)len;
+      _table.symbols[idx] = (uint16_t)i;
+      if (len <= FAST_BITS) {
+        // 输入低位在前，表的下标是反转后的编码
+        for (auto j = reverse_bits(next_code[len], len); j < (1 << FAST_BITS);
+             j += 1U << len) {
+          _table.fast[j] = (uint16_t)((len << 9) | i);
+        }
+      }
+      next_code[len]++;
+    }
+    return true;
+  }
+
+  /**
+   * @brief 解码一个符号
+   * @param  _table          解码表
+   * @return int             符号，编码无效时为 -1
+   */
+  int decode(const huffman_t& _table) {
+    if (bit_count < 16) {
+      refill();
+    }
+    auto fast = _table.fast[bit_buf & ((1 << FAST_BITS) - 1)];
+    if (fast != 0) {
+      size_t len = fast >> 9;
+      bit_buf >>= len;
+      bit_count -= len;
+      return fast & 0x1FF;
+    }
+    // 较长的编码，按长度逐级比较
+    auto code = reverse_bits((uint32_t)(bit_buf & 0xFFFF), 16);
+    size_t len = FAST_BITS + 1;
+    while (len < 16 && code >= _table.max_code[len]) {
+      len++;
+    }
+    if (len >= 16) {
+      return -1;
+    }
+    size_t idx = (code >> (16 - len)) - _table.first_code[len] +
+                 _table.first_symbol[len];
+    if (idx >= LITLEN_COUNT || _table.lengths[idx] != len) {
+      return -1;
+    }
+    bit_buf >>= len;
+    bit_count -= len;
+    return _table.symbols[idx];
+  }
+
+  /**
+   * @brief 建立固定 huffman 编码的解码表
+   */
+  void build_fixed(void) {
+    uint8_t lengths[LITLEN_COUNT];
+    for (size_t i = 0; i < LITLEN_COUNT; i++) {
+      lengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    }
+    build_huffman(litlen, lengths, LITLEN_COUNT);
+    for (size_t i = 0; i < DIST_COUNT; i++) {
+      lengths[i] = 5;
+    }
+    build_huffman(dist, lengths, DIST_COUNT);
+    return;
+  }
+
+  /**
+   * @brief 读取动态 huffman 编码的解码表
+   * @return status_t        结果
+   */
+  status_t build_dynamic(void) {
+    size_t hlit = bits(5) + 257;
+    size_t hdist = bits(5) + 1;
+    size_t hclen = bits(4) + 4;
+    if (hlit > 286 || hdist > 30) {
+      return STATUS_CORRUPT;
+    }
+    uint8_t lengths[LITLEN_COUNT + DIST_COUNT] = {};
+    for (size_t i = 0; i < hclen; i++) {
+      lengths[CODE_LENGTH_ORDER[i]] = (uint8_t)bits(3);
+    }
+    // 编码长度的解码表借用 litlen
+    if (!build_huffman(litlen, lengths, 19)) {
+      return STATUS_CORRUPT;
+    }
+    size_t n = 0;
+    while (n < hlit + hdist) {
+      auto symbol = decode(litlen);
+      if (symbol < 0 || symbol > 18) {
+        return STATUS_CORRUPT;
+      }
+      if (symbol < 16) {
+        lengths[n++] = (uint8_t)symbol;
+        continue;
+      }
+      uint8_t value = 0;
+      size_t repeat;
+      if (symbol == 16) {
+        // 重复上一个长度 3-6 次
+        if (n == 0) {
+          return STATUS_CORRUPT;
+        }
+        value = lengths[n - 1];
+        repeat = 3 + bits(2);
+      } else if (symbol == 17) {
+        repeat = 3 + bits(3);
+      } else {
+        repeat = 11 + bits(7);
+      }
+      if (n + repeat > hlit + hdist) {
+        return STATUS_CORRUPT;
+      }
+      while (repeat-- > 0) {
+        lengths[n++] = value;
+      }
+    }
+    // 必须有结束符号
+    if (lengths[256] == 0) {
+      return STATUS_CORRUPT;
+    }
+    uint8_t dist_lengths[DIST_COUNT] = {};
+    for (size_t i = 0; i < hdist; i++) {
+      dist_lengths[i] = lengths[hlit + i];
+    }
+    for (size_t i = hlit; i < LITLEN_COUNT; i++) {
+      lengths[i] = 0;
+    }
+    if (!build_huffman(litlen, lengths, LITLEN_COUNT) ||
+        !build_huffman(dist, dist_lengths, DIST_COUNT)) {
+      return STATUS_CORRUPT;
+    }
+    return STATUS_OK;
+  }
+
+  /**
+   * @brief 解码一个压缩块的数据
+   * @return status_t        结果
+   */
+  status_t inflate_block(void) {
+    while (1) {
+      auto symbol = decode(litlen);
+      if (symbol < 0) {
+        return STATUS_CORRUPT;
+      }
+      if (symbol < 256) {
+        if (out_pos >= dst_cap) {
+          return STATUS_NO_SPACE;
+        }
+        dst[out_pos++] = (uint8_t)symbol;
+      } else if (symbol == 256) {
+        return STATUS_OK;
+      } else {
+        symbol -= 257;
+        if (symbol >= 29) {
+          return STATUS_CORRUPT;
+        }
+        size_t len = LENGTH_BASE[symbol] + bits(LENGTH_EXTRA[symbol]);
+        auto dist_symbol = decode(dist);
+        if (dist_symbol < 0 || dist_symbol >= 30) {
+          return STATUS_CORRUPT;
+        }
+        size_t distance =
+            DIST_BASE[dist_symbol] + bits(DIST_EXTRA[dist_symbol]);
+        if (distance > out_pos) {
+          return STATUS_CORRUPT;
+        }
+        if (len > dst_cap - out_pos) {
+          return STATUS_NO_SPACE;
+        }
+        copy_match(dst + out_pos, distance, len);
+        out_pos += len;
+      }
+      if (!report(false)) {
+        return STATUS_ABORTED;
+      }
+    }
+  }
+
+  /**
+   * @brief 解压 deflate 数据
+   * @return status_t        结果
+   */
+  status_t inflate(void) {
+    bool final = false;
+    while (!final) {
+      final = bits(1) != 0;
+      auto type = bits(2);
+      status_t res = STATUS_OK;
+      if (type == 0) {
+        // 不压缩的块
+        align_to_byte();
+        if (in_pos + 4 > src_len) {
+          return STATUS_CORRUPT;
+        }
+        size_t len = read_le16(src + in_pos);
+        if ((uint16_t)~len != read_le16(src + in_pos + 2)) {
+          return STATUS_CORRUPT;
+        }
+        in_pos += 4;
+        if (len > src_len - in_pos) {
+          return STATUS_CORRUPT;
+        }
+        if (len > dst_cap - out_pos) {
+          return STATUS_NO_SPACE;
+        }
+        copy_bytes(dst + out_pos, src + in_pos, len);
+        out_pos += len;
+        in_pos += len;
+        if (!report(false)) {
+          return STATUS_ABORTED;
+        }
+      } else if (type == 1) {
+        build_fixed();
+        res = inflate_block();
+      } else if (type == 2) {
+        res = build_dynamic();
+        if (res == STATUS_OK) {
+          res = inflate_block();
+        }
+      } else {
+        res = STATUS_CORRUPT;
+      }
+      if (res != STATUS_OK) {
+        return res;
+      }
+    }
+    align_to_byte();
+    // 读取超出了输入
+    if (in_pos > src_len) {
+      return STATUS_CORRUPT;
+    }
+    return STATUS_OK;
+  }
+
+  /**
+   * @brief 解压 gzip
+   * @return status_t        结果
+   * @note 只处理第一个 member
+   */
+  status_t gunzip(void) {
+    // 固定头
+    if (src_len < 18 || src[2] != 8 || (src[3] & 0xE0) != 0) {
+      return STATUS_CORRUPT;
+    }
+    auto flags = src[3];
+    in_pos = 10;
+    // FEXTRA
+    if (flags & 0x04) {
+      if (in_pos + 2 > src_len) {
+        return STATUS_CORRUPT;
+      }
+      in_pos += 2 + read_le16(src + in_pos);
+    }
+    // FNAME 与 FCOMMENT
+    for (uint8_t flag = 0x08; flag <= 0x10; flag <<= 1) {
+      if (flags & flag) {
+        while (in_pos < src_len && src[in_pos] != 0) {
+          in_pos++;
+        }
+        in_pos++;
+      }
+    }
+    // FHCRC
+    if (flags & 0x02) {
+      in_pos += 2;
+    }
+    if (in_pos > src_len) {
+      return STATUS_CORRUPT;
+    }
+    check_crc = true;
+    auto res = inflate();
+    if (res != STATUS_OK) {
+      return res;
+    }
+    if (!report(true)) {
+      return STATUS_ABORTED;
+    }
+    if (in_pos + 8 > src_len) {
+      return STATUS_CORRUPT;
+    }
+    if (read_le32(src + in_pos) != crc ||
+        read_le32(src + in_pos + 4) != (uint32_t)out_pos) {
+      return STATUS_CHECKSUM;
+    }
+    return STATUS_OK;
+  }
+
+  /**
+   * @brief 解压一个 lz4 块
+   * @param  _data           块数据
+   * @param  _len            块长度
+   * @param  _limit          匹配可以引用的最早输出位置
+   * @return status_t        结果
+   * @see lz4_Block_format.md
+   */
+  status_t lz4_block(const uint8_t* _data, size_t _len, size_t _limit) {
+    size_t pos = 0;
+    while (pos < _len) {
+      auto token = _data[pos++];
+      // 字面量
+      size_t literals = token >> 4;
+      if (literals == 15) {
+        uint8_t byte;
+        do {
+          if (pos >= _len) {
+            return STATUS_CORRUPT;
+          }
+          byte = _data[pos++];
+          literals += byte;
+        } while (byte == 255);
+      }
+      if (literals > _len - pos) {
+        return STATUS_CORRUPT;
+      }
+      if (literals > dst_cap - out_pos) {
+        return STATUS_NO_SPACE;
+      }
+      copy_bytes(dst + out_pos, _data + pos, literals);
+      out_pos += literals;
+      pos += literals;
+      // 最后一个序列只有字面量
+      if (pos == _len) {
+        break;
+      }
+      // 匹配
+      if (_len - pos < 2) {
+        return STATUS_CORRUPT;
+      }
+      size_t offset = read_le16(_data + pos);
+      pos += 2;
+      if (offset == 0 || offset > out_pos - _limit) {
+        return STATUS_CORRUPT;
+      }
+      size_t len = (token & 0x0F) + 4;
+      if ((token & 0x0F) == 15) {
+        uint8_t byte;
+        do {
+          if (pos >= _len) {
+            return STATUS_CORRUPT;
+          }
+          byte = _data[pos++];
+          len += byte;
+        } while (byte == 255);
+      }
+      if (len > dst_cap - out_pos) {
+        return STATUS_NO_SPACE;
+      }
+      copy_match(dst + out_pos, offset, len);
+      out_pos += len;
+      if (!report(false)) {
+        return STATUS_ABORTED;
+      }
+    }
+    return STATUS_OK;
+  }
+
+  /**
+   * @brief 解压 lz4 frame
+   * @return status_t        结果
+   * @see lz4_Frame_format.md
+   */
+  status_t unlz4(void) {
+    // 跳过 skippable frame
+    while (src_len - in_pos >= 8 &&
+           (read_le32(src + in_pos) & 0xFFFFFFF0) == LZ4_SKIPPABLE_MAGIC) {
+      auto size = read_le32(src + in_pos + 4);
+      if (size > src_len - in_pos - 8) {
+        return STATUS_CORRUPT;
+      }
+      in_pos += 8 + size;
+    }
+    if (src_len - in_pos < 7 || read_le32(src + in_pos) != LZ4_MAGIC) {
+      return STATUS_CORRUPT;
+    }
+    in_pos += 4;
+    auto descriptor = src + in_pos;
+    auto flg = descriptor[0];
+    auto bd = descriptor[1];
+    // 版本号为 01，保留位为 0
+    if ((flg >> 6) != 1 || (flg & 0x02) || (bd & 0x8F) ||
+        ((bd >> 4) & 0x07) < 4) {
+      return STATUS_CORRUPT;
+    }
+    if (flg & 0x01) {
+      // 预置字典
+      return STATUS_UNSUPPORTED;
+    }
+    bool independent = (flg & 0x20) != 0;
+    bool block_checksum = (flg & 0x10) != 0;
+    bool content_size = (flg & 0x08) != 0;
+    bool content_checksum = (flg & 0x04) != 0;
+    size_t block_max = (size_t)1 << (8 + 2 * ((bd >> 4) & 0x07));
+    size_t descriptor_len = 2 + (content_size ? 8 : 0);
+    if (src_len - in_pos < descriptor_len + 1) {
+      return STATUS_CORRUPT;
+    }
+    if (((xxh32(descriptor, descriptor_len) >> 8) & 0xFF) !=
+        descriptor[descriptor_len]) {
+      return STATUS_CHECKSUM;
+    }
+    uint64_t expected_size = 0;
+    if (content_size) {
+      expected_size = read_le32(descriptor + 2) |
+                      ((uint64_t)read_le32(descriptor + 6) << 32);
+      if (expected_size > dst_cap) {
+        return STATUS_NO_SPACE;
+      }
+    }
+    in_pos += descriptor_len + 1;
+    xxh32_t content;
+    xxh32_init(content);
+    while (1) {
+      if (src_len - in_pos < 4) {
+        return STATUS_CORRUPT;
+      }
+      auto block_size = read_le32(src + in_pos);
+      in_pos += 4;
+      if (block_size == 0) {
+        break;
+      }
+      // 最高位为 1 表示不压缩
+      bool stored = (block_size & 0x80000000U) != 0;
+      size_t len = block_size & 0x7FFFFFFFU;
+      if (len > block_max ||
+          len + (block_checksum ? 4 : 0) > src_len - in_pos) {
+        return STATUS_CORRUPT;
+      }
+      auto data = src + in_pos;
+      in_pos += len;
+      if (block_checksum) {
+        if (xxh32(data, len) != read_le32(src + in_pos)) {
+          return STATUS_CHECKSUM;
+        }
+        in_pos += 4;
+      }
+      auto block_start = out_pos;
+      if (stored) {
+        if (len > dst_cap - out_pos) {
+          return STATUS_NO_SPACE;
+        }
+        copy_bytes(dst + out_pos, data, len);
+        out_pos += len;
+      } else {
+        auto res = lz4_block(data, len, independent ? block_start : 0);
+        if (res != STATUS_OK) {
+          return res;
+        }
+      }
+      if (out_pos - block_start > block_max) {
+        return STATUS_CORRUPT;
+      }
+      // 块结束时数据还在缓存中，同时计算校验和并通知
+      if (content_checksum) {
+        xxh32_update(content, dst + block_start, out_pos - block_start);
+      }
+      if (!report(true)) {
+        return STATUS_ABORTED;
+      }
+    }
+    if (content_size && out_pos != expected_size) {
+      return STATUS_CORRUPT;
+    }
+    if (content_checksum) {
+      if (src_len - in_pos < 4) {
+        return STATUS_CORRUPT;
+      }
+      if (xxh32_digest(content) != read_le32(src + in_pos)) {
+        return STATUS_CHECKSUM;
+      }
+      in_pos += 4;
+    }
+    return STATUS_OK;
+  }
+
+  /**
+   * @brief 复制未压缩的 dtb
+   * @return status_t        结果
+   */
+  status_t copy(void) {
+    auto total = content_size(src, src_len);
+    if (total == 0 || total > src_len) {
+      return STATUS_CORRUPT;
+    }
+    if (total > dst_cap) {
+      return STATUS_NO_SPACE;
+    }
+    // 按 CHUNK_SIZE 分段复制，每段复制完通知一次
+    while (out_pos < total) {
+      auto len = total - out_pos < CHUNK_SIZE ? total - out_pos : CHUNK_SIZE;
+      copy_bytes(dst + out_pos, src + out_pos, len);
+      out_pos += len;
+      if (!report(false)) {
+        return STATUS_ABORTED;
+      }
+    }
+    return report(true) ? STATUS_OK : STATUS_ABORTED;
+  }
+
+  /**
+   * @brief 增量建立索引使用的参数
+   */
+  template <class Config>
+  struct load_ctx_t {
+    /// 索引
+    basic_fdt_parser<Config>* parser;
+    /// 增量状态
+    typename basic_fdt_index<Config>::stream_t stream;
+  };
+
+  /**
+   * @brief load() 的进度回调，将新数据交给索引
+   * @param  _produced       已经写入的总长度
+   * @param  _ctx            load_ctx_t
+   * @return true            继续
+   * @return false           dtb 格式错误
+   */
+  template <class Config>
+  static bool load_cb(size_t _produced, void* _ctx) {
+    auto ctx = (load_ctx_t<Config>*)_ctx;
+    return ctx->parser->stream_feed(ctx->stream, _produced);
+  }
+
+ public:
+  /// @name 构造/析构函数
+  /// @{
+  fdt_decompressor()
+      : src(nullptr),
+        src_len(0),
+        in_pos(0),
+        bit_buf(0),
+        bit_count(0),
+        dst(nullptr),
+        dst_cap(0),
+        out_pos(0),
+        reported(0),
+        progress(nullptr),
+        ctx(nullptr),
+        crc(0),
+        check_crc(false) {}
+  fdt_decompressor(const fdt_decompressor& _fdt_decompressor) = delete;
+  fdt_decompressor(fdt_decompressor&& _fdt_decompressor) = delete;
+  auto operator=(const fdt_decompressor& _fdt_decompressor)
+      -> fdt_decompressor& = delete;
+  auto operator=(fdt_decompressor&& _fdt_decompressor)
+      -> fdt_decompressor& = delete;
+  ~fdt_decompressor() = default;
+  /// @}
+
+  /**
+   * @brief 根据魔数判断格式
+   * @param  _src            输入
+   * @param  _src_len        输入长度
+   * @return format_t        格式
+   */
+  static format_t detect(const void* _src, size_t _src_len) {
+    auto p = (const uint8_t*)_src;
+    if (_src_len >= 4 && p[0] == 0xD0 && p[1] == 0x0D && p[2] == 0xFE &&
+        p[3] == 0xED) {
+      return FORMAT_FDT;
+    }
+    if (_src_len >= 2 && p[0] == 0x1F && p[1] == 0x8B) {
+      return FORMAT_GZIP;
+    }
+    if (_src_len >= 4 && (read_le32(p) == LZ4_MAGIC ||
+                          (read_le32(p) & 0xFFFFFFF0) == LZ4_SKIPPABLE_MAGIC)) {
+      return FORMAT_LZ4;
+    }
+    return FORMAT_UNKNOWN;
+  }
+
+  /**
+   * @brief 获取解压后的长度，用于分配输出缓冲区
+   * @param  _src            输入
+   * @param  _src_len        输入长度
+   * @return size_t          解压后的长度，无法提前得知时为 0
+   * @note gzip 使用末尾的 ISIZE，lz4 只在 frame 头包含长度时有效
+   */
+  static size_t content_size(const void* _src, size_t _src_len) {
+    auto p = (const uint8_t*)_src;
+    switch (detect(_src, _src_len)) {
+      case FORMAT_FDT: {
+        if (_src_len < 8) {
+          return 0;
+        }
+        return ((size_t)p[4] << 24) | ((size_t)p[5] << 16) |
+               ((size_t)p[6] << 8) | p[7];
+      }
+      case FORMAT_GZIP: {
+        return (_src_len >= 18) ? read_le32(p + _src_len - 4) : 0;
+      }
+      case FORMAT_LZ4: {
+        if (_src_len < 15 || read_le32(p) != LZ4_MAGIC || !(p[4] & 0x08)) {
+          return 0;
+        }
+        return read_le32(p + 6);
+      }
+      default: {
+        return 0;
+      }
+    }
+  }
+
+  /**
+   * @brief 解压到 _dst
+   * @param  _src            输入，gzip、lz4 frame 或未压缩的 dtb
+   * @param  _src_len        输入长度
+   * @param  _dst            输出缓冲区
+   * @param  _dst_cap        输出缓冲区长度
+   * @param  _progress       进度回调，可以为 nullptr
+   * @param  _ctx            回调参数
+   * @return status_t        结果
+   */
+  status_t decompress(const void* _src, size_t _src_len, void* _dst,
+                      size_t _dst_cap, progress_t _progress = nullptr,
+                      void* _ctx = nullptr) {
+    reset(_src, _src_len, _dst, _dst_cap, _progress, _ctx);
+    switch (detect(_src, _src_len)) {
+      case FORMAT_FDT: {
+        return copy();
+      }
+      case FORMAT_GZIP: {
+        return gunzip();
+      }
+      case FORMAT_LZ4: {
+        return unlz4();
+      }
+      default: {
+        return STATUS_UNKNOWN_FORMAT;
+      }
+    }
+  }
+
+  /**
+   * @brief 解压的同时建立索引
+   * @param  _parser         索引
+   * @param  _src            输入，gzip、lz4 frame 或未压缩的 dtb
+   * @param  _src_len        输入长度
+   * @param  _dst            输出缓冲区，之后索引指向这里
+   * @param  _dst_cap        输出缓冲区长度
+   * @param  _flags          DT_INIT_* 标志
+   * @return status_t        结果，失败时 _parser 为空
+   * @note 结果与先 decompress() 再 dtb_init() 相同，但数据区只在解压时
+   * 读取一次
+   * @note 不一定更快：dtb 在缓存中时省下的读取很少，lz4 解压又很快，
+   * 分段调用 stream_feed() 的开销可能超过省下的读取，riscv64_qemu_virt.dtb
+   * 上 lz4 有时比先 decompress() 再 dtb_init() 慢约 5%
+   */
+  template <class Config>
+  status_t load(basic_fdt_parser<Config>& _parser, const void* _src,
+                size_t _src_len, void* _dst, size_t _dst_cap,
+                uint8_t _flags = 0) {
+    load_ctx_t<Config> load_ctx;
+    load_ctx.parser = &_parser;
+    _parser.stream_begin(load_ctx.stream, (uintptr_t)_dst, _dst_cap);
+    auto res = decompress(_src, _src_len, _dst, _dst_cap, load_cb<Config>,
+                          &load_ctx);
+    // 中止说明 stream_feed() 发现了格式错误
+    if (res == STATUS_ABORTED ||
+        (res == STATUS_OK && !_parser.stream_finish(load_ctx.stream, _flags))) {
+      res = STATUS_BAD_DTB;
+    }
+    if (res != STATUS_OK) {
+      // 清空已经建立的部分
+      _parser.stream_begin(load_ctx.stream, (uintptr_t)_dst, _dst_cap);
+    }
+    return res;
+  }
+
+  /**
+   * @brief 解压后的长度
+   * @return size_t          上一次 decompress() 或 load() 写入的长度
+   */
+  size_t size(void) const { return out_pos; }
+};
+
+// 嵌套类型在类定义结束后才完整，不能在类内进行常量初始化
+inline constexpr const fdt_decompressor::crc32_table_t
+    fdt_decompressor::CRC32 = fdt_decompressor::crc32_table_t();
+
+}  // namespace FDT_PARSER
+
+#endif /* FDT_PARSER_SRC_INCLUDE_FDT_DECOMPRESSOR_H */
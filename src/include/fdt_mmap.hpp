@@ -0,0 +1,119 @@
+
+// This file is a part of MRNIU/fdt-parser
+// (https://github.com/MRNIU/fdt-parser).
+//
+// fdt_mmap.hpp for MRNIU/fdt-parser.
+
+#ifndef FDT_PARSER_SRC_INCLUDE_FDT_MMAP_H
+#define FDT_PARSER_SRC_INCLUDE_FDT_MMAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fdt_parser.hpp"
+
+namespace FDT_PARSER {
+
+/**
+ * @brief 以只读方式映射 dtb 文件，仅用于宿主机上的工具
+ * @note 映射后直接交给 fdt_parser 使用，不复制文件内容，
+ * 启动时间只与实际访问的页数有关，析构时解除映射
+ * @note 解析得到的索引中的名称指向映射，不能比本对象活得更久
+ */
+class fdt_mmap {
+ public:
+  /**
+   * @brief 映射结果
+   */
+  enum status_t : uint8_t {
+    /// 成功
+    STATUS_OK = 0,
+    /// 无法打开或读取文件信息
+    STATUS_OPEN_FAILED,
+    /// mmap 失败
+    STATUS_MMAP_FAILED,
+    /// 文件小于 fdt 头或魔数错误
+    STATUS_BAD_MAGIC,
+    /// 版本错误，totalsize 或各区域超出文件大小，或没有按要求对齐
+    STATUS_BAD_HEADER,
+  };
+
+ private:
+  /// 映射地址
+  void* map_addr;
+  /// 映射长度，即文件大小
+  size_t map_len;
+  /// 映射结果
+  status_t map_status;
+
+  /**
+   * @brief 检查映射的内容是否是完整的 dtb
+   * @return status_t        检查结果
+   * @note 使用 fdt_index::header_ok() 与 fdt_index::reserved_ok()
+   */
+  status_t check(void) const;
+
+  /**
+   * @brief 解除映射
+   */
+  void unmap(void);
+
+ public:
+  /**
+   * 构造函数
+   * @param _path dtb 文件路径
+   */
+  explicit fdt_mmap(const char* _path);
+
+  /// @name 默认构造/析构函数
+  /// @{
+  fdt_mmap()
+      : map_addr(nullptr), map_len(0), map_status(STATUS_OPEN_FAILED) {}
+  fdt_mmap(const fdt_mmap& _fdt_mmap) = delete;
+  fdt_mmap(fdt_mmap&& _fdt_mmap);
+  auto operator=(const fdt_mmap& _fdt_mmap) -> fdt_mmap& = delete;
+  auto operator=(fdt_mmap&& _fdt_mmap) -> fdt_mmap&;
+  ~fdt_mmap();
+  /// @}
+
+  /**
+   * @brief 是否映射成功且通过检查
+   * @return true            是
+   * @return false           否
+   */
+  bool valid(void) const { return map_status == STATUS_OK; }
+
+  /**
+   * @brief 获取映射结果
+   * @return status_t        映射结果
+   */
+  status_t status(void) const { return map_status; }
+
+  /**
+   * @brief 获取 dtb 地址
+   * @return uintptr_t       dtb 地址，失败时为 0
+   */
+  uintptr_t addr(void) const { return valid() ? (uintptr_t)map_addr : 0; }
+
+  /**
+   * @brief 获取文件大小
+   * @return size_t          文件大小，失败时为 0
+   */
+  size_t size(void) const { return valid() ? map_len : 0; }
+
+  /**
+   * @brief 解析映射的 dtb
+   * @param  _flags          传递给 dtb_init 的选项
+   * @return fdt_parser      解析结果，映射失败时为空的 fdt_parser
+   */
+  fdt_parser parser(uint8_t _flags = 0) const {
+    if (!valid()) {
+      return fdt_parser();
+    }
+    return fdt_parser(addr(), _flags);
+  }
+};
+
+}  // namespace FDT_PARSER
+
+#endif /* FDT_PARSER_SRC_INCLUDE_FDT_MMAP_H */
@@ -7,8 +7,10 @@
 #ifndef FDT_PARSER_SRC_INCLUDE_FDT_PARSER_H
 #define FDT_PARSER_SRC_INCLUDE_FDT_PARSER_H
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
 #include <utility>
 
 // See devicetree-specification-v0.3.pdf
@@ -54,6 +56,14 @@ static size_t fdt_strlen(const char* s) {
   return len;
 }
 
+// FNV-1a 哈希，可以通过 _hash 接着上一次的结果计算
+static inline uint32_t fdt_hash(const char* s, uint32_t _hash = 0x811C9DC5) {
+  while (*s) {
+    _hash = (_hash ^ (uint8_t)*s++) * 0x01000193;
+  }
+  return _hash;
+}
+
 // fdt_parser_be32toh 函数
 static inline uint32_t fdt_parser_be32toh(uint32_t big_endian_32bits) {
   // 判断系统是否为小端序
@@ -113,8 +123,554 @@ struct resource_t {
   }
 };
 
-class fdt_parser final {
+/**
+ * @brief cpu 与 numa 拓扑信息，供调度器直接使用的扁平数组
+ * @see linux/Documentation/devicetree/bindings/cpu/cpu-topology.txt
+ * @see linux/Documentation/devicetree/bindings/numa.txt
+ */
+struct cpu_topology_t {
+  /// 最大 cpu 数
+  static constexpr const size_t MAX_CPUS = 64;
+  /// 最大 numa 节点数
+  static constexpr const size_t MAX_NUMA_NODES = 8;
+  /// cpu 掩码字数
+  static constexpr const size_t MASK_WORDS = (MAX_CPUS + 63) / 64;
+  /// 本地距离
+  static constexpr const uint32_t LOCAL_DISTANCE = 10;
+  /// 远端距离
+  static constexpr const uint32_t REMOTE_DISTANCE = 20;
+
+  /**
+   * @brief 单个 cpu 的信息
+   */
+  struct cpu_t {
+    /// hart id，即 reg
+    uint64_t hartid;
+    /// riscv,isa 字符串
+    char* isa;
+    /// 单字母扩展位图，第 n 位表示 'a' + n
+    uint32_t isa_ext;
+    /// phandle
+    uint32_t phandle;
+    /// numa-node-id
+    uint32_t numa_node;
+    /// cpu-map 中的位置
+    uint16_t socket;
+    uint16_t cluster;
+    uint16_t core;
+    uint16_t thread;
+    /// 指令缓存，单位为 bytes
+    uint32_t i_cache_size;
+    uint32_t i_cache_sets;
+    uint32_t i_cache_block_size;
+    /// 数据缓存，单位为 bytes
+    uint32_t d_cache_size;
+    uint32_t d_cache_sets;
+    uint32_t d_cache_block_size;
+    /// next-level-cache 的 phandle
+    uint32_t next_level_cache;
+    /// status 为 okay 或不存在
+    bool enabled;
+  };
+
+  /// cpu 数组，按 /cpus 下的顺序排列
+  cpu_t cpus[MAX_CPUS];
+  /// 有效 cpu 数
+  size_t cpu_count;
+  /// numa 距离矩阵，distance[from][to]，与 distance-matrix 同为 u32
+  uint32_t distance[MAX_NUMA_NODES][MAX_NUMA_NODES];
+  /// 每个 numa 节点包含的 cpu，第 n 位对应 cpus[n]
+  uint64_t node_cpus[MAX_NUMA_NODES][MASK_WORDS];
+  /// 有效 numa 节点数
+  size_t node_count;
+
+  /**
+   * @brief 根据 hart id 查找 cpu
+   * @param  _hartid         要查找的 hart id
+   * @return const cpu_t*    找到的 cpu，未找到时为 nullptr
+   */
+  const cpu_t* find_cpu(uint64_t _hartid) const {
+    for (size_t i = 0; i < cpu_count; i++) {
+      if (cpus[i].hartid == _hartid) {
+        return &cpus[i];
+      }
+    }
+    return nullptr;
+  }
+};
+
+/**
+ * @brief 索引的容量与功能，作为 basic_fdt_index 的模板参数
+ * @note 继承后覆盖需要修改的项即可，关闭的功能在编译期去掉对应的字段、
+ * 数组与初始化步骤，调用关闭功能的查询接口会导致编译错误
+ */
+struct fdt_config_t {
+  /// 路径最大深度
+  static constexpr const size_t MAX_DEPTH = 16;
+  /// 最大节点数
+  static constexpr const size_t MAX_NODES_COUNT = 128;
+  /// 最大属性数
+  static constexpr const size_t PROP_MAX_COUNT = 16;
+  /// 建立 phandle 映射
+  static constexpr const bool PHANDLES = true;
+  /// 解析 interrupt-parent，需要 PHANDLES
+  static constexpr const bool INTERRUPT_PARENTS = true;
+  /// 建立兄弟节点链接，支持 first_child()、find_child() 与 diff()
+  /// @note 路径查找只使用父节点链接，始终可用
+  static constexpr const bool SIBLINGS = true;
+  /// 支持 DT_INIT_HASH 子树哈希
+  static constexpr const bool HASHES = true;
+  /// 初始化时为 device_type = "memory" 与 status = "okay" 建立倒排索引，
+  /// select() 只检查索引中的节点
+  static constexpr const bool INVERTED_INDEXES = true;
+  /// fill_node_resource() 支持的 resource_t 类型
+  static constexpr const uint8_t RESOURCES =
+      resource_t::MEM | resource_t::INTR_NO | resource_t::FREQUENCY;
+};
+
+/**
+ * @brief 用于 M 态固件等只需要查找内存与外设地址的场景
+ */
+struct fdt_tiny_config_t : fdt_config_t {
+  static constexpr const size_t MAX_DEPTH = 8;
+  static constexpr const size_t MAX_NODES_COUNT = 32;
+  static constexpr const size_t PROP_MAX_COUNT = 12;
+  static constexpr const bool PHANDLES = false;
+  static constexpr const bool INTERRUPT_PARENTS = false;
+  static constexpr const bool SIBLINGS = false;
+  static constexpr const bool HASHES = false;
+  static constexpr const bool INVERTED_INDEXES = false;
+  static constexpr const uint8_t RESOURCES = resource_t::MEM;
+};
+
+/**
+ * @brief 用于引导 Linux 等需要完整设备树的场景
+ */
+struct fdt_large_config_t : fdt_config_t {
+  static constexpr const size_t MAX_DEPTH = 32;
+  static constexpr const size_t MAX_NODES_COUNT = 1024;
+  static constexpr const size_t PROP_MAX_COUNT = 32;
+};
+
+/**
+ * @brief 关闭 HASHES 时为空基类，不占用节点空间
+ */
+template <bool>
+struct fdt_node_hash_t {
+  /// 子树哈希，包括节点名、属性与所有子节点，使用 DT_INIT_HASH 初始化时有效
+  uint64_t hash;
+};
+template <>
+struct fdt_node_hash_t<false> {};
+
+/**
+ * @brief 关闭 SIBLINGS 时为空基类，不占用节点空间
+ */
+template <bool>
+struct fdt_node_sibling_t {
+  /// 下一个兄弟节点下标，没有时为 NO_NODE
+  uint32_t sibling;
+};
+template <>
+struct fdt_node_sibling_t<false> {};
+
+/**
+ * @brief 关闭 INTERRUPT_PARENTS 时为空基类，不占用节点空间
+ */
+template <bool>
+struct fdt_node_interrupt_parent_t {
+  /// 中断父节点下标，没有时为 NO_NODE
+  uint32_t interrupt_parent;
+};
+template <>
+struct fdt_node_interrupt_parent_t<false> {};
+
+/**
+ * @brief 通过 fdt_index::validate() 检查的 dtb
+ * @note 非空的对象只能由 validate() 构造，持有它说明 dtb 的头信息、
+ * token 序列与属性名都在 totalsize 内，接受它的接口不再逐次检查边界
+ * @note 检查之后 dtb 的内容不能再被修改
+ */
+class fdt_validated_t {
  private:
+  /// dtb 地址，为 0 表示没有通过检查
+  uintptr_t addr;
+  /// dtb 总长度
+  uint32_t size;
+  /// 最大深度
+  uint32_t depth;
+  /// 节点数
+  uint32_t nodes_count;
+  /// 单个节点的最大属性数
+  uint32_t props_count;
+  /// phandle 数
+  uint32_t phandles_count;
+
+  /**
+   * 构造函数
+   * @param _addr dtb 地址
+   * @param _size dtb 总长度
+   * @param _depth 最大深度
+   * @param _nodes_count 节点数
+   * @param _props_count 单个节点的最大属性数
+   * @param _phandles_count phandle 数
+   */
+  fdt_validated_t(uintptr_t _addr, uint32_t _size, uint32_t _depth,
+                  uint32_t _nodes_count, uint32_t _props_count,
+                  uint32_t _phandles_count)
+      : addr(_addr),
+        size(_size),
+        depth(_depth),
+        nodes_count(_nodes_count),
+        props_count(_props_count),
+        phandles_count(_phandles_count) {}
+
+  template <class>
+  friend class basic_fdt_index;
+
+ public:
+  /// @name 默认构造/析构函数
+  /// @{
+  fdt_validated_t()
+      : addr(0),
+        size(0),
+        depth(0),
+        nodes_count(0),
+        props_count(0),
+        phandles_count(0) {}
+  fdt_validated_t(const fdt_validated_t& _fdt_validated) = default;
+  fdt_validated_t(fdt_validated_t&& _fdt_validated) = default;
+  auto operator=(const fdt_validated_t& _fdt_validated)
+      -> fdt_validated_t& = default;
+  auto operator=(fdt_validated_t&& _fdt_validated)
+      -> fdt_validated_t& = default;
+  ~fdt_validated_t() = default;
+  /// @}
+
+  /**
+   * @brief 是否通过了检查
+   * @return true            是
+   * @return false           否
+   */
+  bool valid(void) const { return addr != 0; }
+
+  /**
+   * @brief 是否可以使用 Config 建立索引
+   * @tparam Config          索引配置
+   * @return true            节点数、深度与属性数都在 Config 的容量内
+   * @return false           超出容量或没有通过检查
+   */
+  template <class Config>
+  bool fits(void) const {
+    return valid() && depth <= Config::MAX_DEPTH &&
+           nodes_count <= Config::MAX_NODES_COUNT &&
+           props_count <= Config::PROP_MAX_COUNT &&
+           (!Config::PHANDLES || phandles_count <= Config::MAX_NODES_COUNT);
+  }
+
+  /**
+   * @brief 是否可以建立索引
+   * @return true            节点数、深度与属性数都在 fdt_index 的容量内
+   * @return false           超出容量或没有通过检查
+   */
+  bool fits_index(void) const { return fits<fdt_config_t>(); }
+
+  /**
+   * @brief 获取 dtb 地址
+   * @return uintptr_t       dtb 地址，没有通过检查时为 0
+   */
+  uintptr_t dtb_addr(void) const { return addr; }
+
+  /**
+   * @brief 获取 dtb 总长度
+   * @return uint32_t        totalsize
+   */
+  uint32_t dtb_size(void) const { return size; }
+};
+
+class fdt_serializer;
+class fdt_mmap;
+
+/**
+ * @brief 解析后的 dtb 索引
+ * @note 构建完成后不再修改，节点之间使用下标关联，属性与节点名使用相对 dtb
+ * 头的偏移，索引本身不包含指向自身的指针，可以直接复制/移动到其它地址使用
+ * @note 所有查询都是 const 的，只读取索引与 dtb，只写入调用者提供的缓冲区，
+ * 构建完成并发布后可以在多个 hart 上并发调用，发布见 fdt_shared_index
+ * @tparam Config 容量与功能，见 fdt_config_t
+ */
+template <class Config>
+class basic_fdt_index {
+ public:
+  /// 索引配置
+  typedef Config config_t;
+  /// 路径最大深度
+  static constexpr const size_t MAX_DEPTH = Config::MAX_DEPTH;
+  /// 最大节点数
+  static constexpr const size_t MAX_NODES_COUNT = Config::MAX_NODES_COUNT;
+  /// 最大属性数
+  static constexpr const size_t PROP_MAX_COUNT = Config::PROP_MAX_COUNT;
+  /// update() 替换的子树中最多的 phandle 数，超过时重新建立全部索引
+  static constexpr const size_t MAX_UPDATE_PHANDLES = 8;
+  /// 无效节点下标
+  static constexpr const uint32_t NO_NODE = 0xFFFFFFFF;
+
+  static_assert(Config::PHANDLES || !Config::INTERRUPT_PARENTS,
+                "INTERRUPT_PARENTS requires PHANDLES");
+  static_assert(MAX_DEPTH <= 0xFF, "node_t::depth is 8 bits");
+
+  /**
+   * @brief 属性信息
+   */
+  struct prop_t {
+    /// 属性名相对字符区的偏移
+    uint32_t nameoff;
+    /// 属性数据相对 dtb 头的偏移
+    uint32_t off;
+    /// 属性长度
+    uint32_t len;
+  };
+
+  /**
+   * @brief 节点数据
+   * @note sibling、interrupt_parent 与 hash 只在对应功能打开时存在
+   */
+  struct node_t : fdt_node_hash_t<Config::HASHES>,
+                  fdt_node_sibling_t<Config::SIBLINGS>,
+                  fdt_node_interrupt_parent_t<Config::INTERRUPT_PARENTS> {
+    /// FDT_BEGIN_NODE 相对 dtb 头的偏移
+    uint32_t off;
+    /// 父节点下标，根节点为 NO_NODE
+    uint32_t parent;
+    /// 1 cell == 4 bytes
+    /// 地址长度 单位为 bytes
+    uint32_t address_cells;
+    /// 长度长度 单位为 bytes
+    uint32_t size_cells;
+    /// 中断长度 单位为 bytes
+    uint32_t interrupt_cells;
+    uint32_t phandle;
+    /// 路径深度
+    uint8_t depth;
+    /// 属性
+    prop_t props[PROP_MAX_COUNT];
+    /// 属性数
+    size_t prop_count;
+  };
+
+  /**
+   * @brief 两个索引之间的差异
+   */
+  struct diff_t {
+    /// 差异类型
+    enum type_t : uint8_t {
+      /// 新增节点，new_node 为新增的节点，old_node 为其父节点
+      NODE_ADDED = 0,
+      /// 删除节点，old_node 为删除的节点，new_node 为其父节点
+      NODE_REMOVED,
+      /// 新增属性
+      PROP_ADDED,
+      /// 删除属性
+      PROP_REMOVED,
+      /// 属性值改变
+      PROP_CHANGED,
+    };
+    /// 差异类型
+    type_t type;
+    /// 旧索引中的节点下标
+    uint32_t old_node;
+    /// 新索引中的节点下标
+    uint32_t new_node;
+    /// 旧索引中的属性，节点差异或新增属性时为 nullptr
+    const prop_t* old_prop;
+    /// 新索引中的属性，节点差异或删除属性时为 nullptr
+    const prop_t* new_prop;
+  };
+
+  /// diff 回调函数类型
+  typedef void (*diff_callback_t)(const diff_t&, void*);
+
+  /**
+   * @brief find_batch() 的一个查询
+   */
+  struct query_t {
+    /// 查询类型
+    enum type_t : uint8_t {
+      /// 与 find_via_prefix() 相同，比较节点名前缀
+      PREFIX = 0,
+      /// 与 find_via_path() 相同，可以省略 unit address
+      PATH,
+      /// 与 find_via_compatible() 相同
+      COMPATIBLE,
+    };
+    /// 查询类型
+    type_t type;
+    /// 需要的 resource_t 类型，resource_t::MEM 等的组合
+    uint8_t resource_types;
+    /// 前缀、路径或 compatible
+    const char* key;
+    /// 结果数组，由调用者提供
+    resource_t* resource;
+    /// 结果数组的长度
+    size_t capacity;
+    /// 匹配的节点数，可能大于 capacity，此时只填充前 capacity 个
+    size_t count;
+    /// PREFIX 时为 key 的长度，PATH 时为路径的层数，由 find_batch() 计算
+    size_t key_len;
+    /// PATH 时为最后一级名称在 key 中的偏移，由 find_batch() 计算
+    size_t key_tail;
+
+    /**
+     * 构造函数
+     * @param _type 查询类型
+     * @param _resource_types 需要的 resource_t 类型
+     * @param _key 前缀、路径或 compatible
+     * @param _resource 结果数组
+     * @param _capacity 结果数组的长度
+     */
+    query_t(type_t _type, uint8_t _resource_types, const char* _key,
+            resource_t* _resource, size_t _capacity)
+        : type(_type),
+          resource_types(_resource_types),
+          key(_key),
+          resource(_resource),
+          capacity(_capacity),
+          count(0),
+          key_len(0),
+          key_tail(0) {}
+  };
+
+  /**
+   * @brief compile() 的一个条件
+   */
+  struct predicate_t {
+    /// 条件类型
+    enum type_t : uint8_t {
+      /// 完整路径匹配 key，'*' 匹配一级名称中任意个字符，'?' 匹配一个字符，
+      /// 与 find_via_path() 相同，省略 unit address 时匹配任意 unit address
+      PATH = 0,
+      /// 存在属性 key
+      HAS_PROP,
+      /// 字符串或字符串列表属性 key 中有一项等于 str
+      STRING,
+      /// 属性 key 的第 cell 个 cell 等于 value
+      CELL,
+    };
+    /// 条件类型
+    type_t type;
+    /// PATH 时为路径，其余为属性名
+    const char* key;
+    /// STRING 时要查找的字符串
+    const char* str;
+    /// CELL 时要比较的值
+    uint32_t value;
+    /// CELL 时 cell 的下标
+    uint32_t cell;
+
+    /**
+     * 构造函数
+     * @param _type 条件类型
+     * @param _key 路径或属性名
+     * @param _str STRING 时要查找的字符串
+     * @param _value CELL 时要比较的值
+     * @param _cell CELL 时 cell 的下标
+     */
+    predicate_t(type_t _type, const char* _key, const char* _str = nullptr,
+                uint32_t _value = 0, uint32_t _cell = 0)
+        : type(_type), key(_key), str(_str), value(_value), cell(_cell) {}
+    predicate_t() : predicate_t(PATH, nullptr) {}
+  };
+
+  /**
+   * @brief compile() 的结果，select() 按此遍历一次索引
+   * @note 只保存条件中的指针，字符串需要在使用期间保持有效
+   */
+  struct plan_t {
+    /// 最多的条件数
+    static constexpr const size_t MAX_STEPS = 8;
+    /// 倒排索引
+    enum index_t : uint8_t {
+      /// device_type = "memory"
+      INDEX_MEMORY = 0x01,
+      /// status = "okay"
+      INDEX_OKAY = 0x02,
+    };
+    /// 需要逐个节点检查的条件，PATH 在前，属性条件在后
+    predicate_t steps[MAX_STEPS];
+    /// PATH 条件的层数，与 steps 对应
+    uint8_t depths[MAX_STEPS];
+    /// steps 的长度
+    size_t count;
+    /// 第一个属性条件在 steps 中的下标
+    size_t props_begin;
+    /// 已由倒排索引满足的条件，INDEX_* 的组合
+    uint8_t indexes;
+    /// compatible 条件在 steps 中的下标，没有时为 MAX_STEPS
+    size_t compatible;
+
+    plan_t() : count(0), props_begin(0), indexes(0), compatible(MAX_STEPS) {}
+  };
+
+  /**
+   * @brief 增量建立索引的状态，见 stream_begin()
+   * @note 由 stream_begin() 初始化，调用者只负责保存，不应修改其内容
+   */
+  struct stream_t {
+    /// 处理阶段
+    enum stage_t : uint8_t {
+      /// 等待头信息
+      STAGE_HEADER = 0,
+      /// 处理保留区与数据区
+      STAGE_BODY,
+      /// 数据区已结束，等待 stream_finish()
+      STAGE_END,
+      /// dtb 格式错误
+      STAGE_ERROR,
+    };
+    /// 处理阶段
+    stage_t stage;
+    /// 缓冲区长度
+    size_t size;
+    /// 已经写入缓冲区的长度
+    size_t avail;
+    /// dtb 总长度
+    uint32_t total;
+    /// 保留区偏移
+    uint32_t reserved;
+    /// 数据区偏移
+    uint32_t data;
+    /// 数据区结束偏移
+    uint32_t data_end;
+    /// 字符区偏移
+    uint32_t str;
+    /// 字符区长度
+    uint32_t str_size;
+    /// 保留区中下一项的偏移
+    uint32_t reserved_pos;
+    /// 下一个 token 的偏移
+    uint32_t pos;
+    /// 当前深度
+    uint32_t depth;
+    /// 节点数
+    uint32_t nodes_count;
+    /// 当前节点的属性数
+    uint32_t props_count;
+    /// 保留区已结束
+    bool reserved_done;
+    /// 根节点已结束
+    bool root_done;
+    /// 刚结束了一个子节点，此时不能再出现父节点的属性
+    bool after_child;
+    /// 超出索引容量，之后只检查格式
+    bool overflow;
+  };
+
+ protected:
+  /// 输出时需要 token 与属性格式
+  friend class fdt_serializer;
+  /// 映射文件时需要检查 fdt 头
+  friend class fdt_mmap;
+
   /// @see devicetree-specification-v0.3.pdf#5.4
   /// node 开始标记
   static constexpr const uint32_t FDT_BEGIN_NODE = 0x1;
@@ -188,37 +744,24 @@ class fdt_parser final {
     uint32_t* data;
   };
 
-  /// 路径最大深度
-  static constexpr const size_t MAX_DEPTH = 16;
-  /// 最大节点数
-  static constexpr const size_t MAX_NODES_COUNT = 128;
-  /// 最大属性数
-  static constexpr const size_t PROP_MAX_COUNT = 16;
-
   /**
    * @brief dtb 信息
    */
   struct dtb_info_t {
-    /// dtb 头
-    fdt_header_t* header;
-    /// 保留区
-    fdt_reserve_entry_t* reserved;
-    /// 数据区
-    uintptr_t data;
-    /// 字符区
-    uintptr_t str;
-  };
-
-  /**
-   * @brief 属性信息
-   */
-  struct prop_t {
-    /// 属性名
-    char* name;
-    /// 属性地址
-    uintptr_t addr;
-    /// 属性长度
-    size_t len;
+    /// dtb 地址，也是所有偏移的基准
+    uintptr_t base;
+    /// dtb 总长度
+    uint32_t size;
+    /// 保留区偏移
+    uint32_t reserved;
+    /// 数据区偏移
+    uint32_t data;
+    /// 数据区长度
+    uint32_t data_size;
+    /// 字符区偏移
+    uint32_t str;
+    /// 字符区长度
+    uint32_t str_size;
   };
 
   /**
@@ -229,70 +772,6 @@ class fdt_parser final {
     char* path[MAX_DEPTH];
     /// 长度
     size_t len;
-
-    /**
-     * @brief 全部匹配
-     * @param  _path           要比较的路径
-     * @return true            相同
-     * @return false           不同
-     */
-    bool operator==(const path_t* _path) {
-      if (len != _path->len) {
-        return false;
-      }
-      for (size_t i = 0; i < len; i++) {
-        if (fdt_strcmp(path[i], _path->path[i]) != 0) {
-          return false;
-        }
-      }
-      return true;
-    }
-
-    bool operator==(const char* _path) {
-      // 路径必须以 ‘/’ 开始
-      if (_path[0] != '/') {
-        return false;
-      }
-      // 记录当前 _path 处理到的下标
-      size_t tmp = 0;
-      for (size_t i = 0; i < len; i++) {
-        if (fdt_strncmp(path[i], &_path[tmp + i], fdt_strlen(path[i])) != 0) {
-          return false;
-        }
-        tmp += fdt_strlen(path[i]);
-      }
-      return true;
-    }
-  };
-
-  /**
-   * @brief 节点数据
-   */
-  struct node_t {
-    /// 节点路径
-    path_t path;
-    /// 节点地址
-    uint32_t* addr;
-    /// 父节点
-    node_t* parent;
-    /// 中断父节点
-    node_t* interrupt_parent;
-    /// 1 cell == 4 bytes
-    /// 地址长度 单位为 bytes
-    uint32_t address_cells;
-    /// 长度长度 单位为 bytes
-    uint32_t size_cells;
-    /// 中断长度 单位为 bytes
-    uint32_t interrupt_cells;
-    uint32_t phandle;
-    /// 路径深度
-    uint8_t depth;
-    /// 属性
-    prop_t props[PROP_MAX_COUNT];
-    /// 属性数
-    size_t prop_count;
-    /// 查找节点中的键值对
-    bool find(const char* _prop_name, const char* _val);
   };
 
   /**
@@ -312,7 +791,7 @@ class fdt_parser final {
     /// 如果节点类型为 PROP， 保存属性地址
     uint32_t* prop_addr;
     /// 在 nodes 数组的下标
-    uint8_t nodes_idx;
+    uint32_t nodes_idx;
   };
 
   // 部分属性及格式
@@ -361,6 +840,7 @@ class fdt_parser final {
       {.prop_name = (char*)"compatible", .fmt = FMT_STRINGLIST},
       {.prop_name = (char*)"model", .fmt = FMT_STRING},
       {.prop_name = (char*)"phandle", .fmt = FMT_U32},
+      {.prop_name = (char*)"linux,phandle", .fmt = FMT_U32},
       {.prop_name = (char*)"status", .fmt = FMT_STRING},
       {.prop_name = (char*)"#address-cells", .fmt = FMT_U32},
       {.prop_name = (char*)"#size-cells", .fmt = FMT_U32},
@@ -376,7 +856,9 @@ class fdt_parser final {
       {.prop_name = (char*)"interrupt-controller", .fmt = FMT_EMPTY},
       {.prop_name = (char*)"value", .fmt = FMT_U32},
       {.prop_name = (char*)"offset", .fmt = FMT_U32},
-      {.prop_name = (char*)"regmap", .fmt = FMT_U32},
+      {.prop_name = (char*)"regmap", .fmt = FMT_PHANDLE},
+      {.prop_name = (char*)"cpu", .fmt = FMT_PHANDLE},
+      {.prop_name = (char*)"next-level-cache", .fmt = FMT_PHANDLE},
   };
 
   /**
@@ -384,28 +866,110 @@ class fdt_parser final {
    */
   struct phandle_map_t {
     uint32_t phandle;
-    node_t* node;
+    /// 节点下标
+    uint32_t node;
   };
 
   /// dtb 信息
   dtb_info_t dtb_info;
+  /// 初始化时使用的 DT_INIT_* 标志
+  uint8_t init_flags;
   /// 节点数组，有效节点数量
   typedef std::pair<node_t[MAX_NODES_COUNT], size_t> nodes_t;
   nodes_t nodes;
-  /// phandle 数组，有效 phandle 数量
-  typedef std::pair<phandle_map_t[MAX_NODES_COUNT], size_t> phandle_maps_t;
+  /// phandle 数组，有效 phandle 数量，关闭 PHANDLES 时只保留一项
+  typedef std::pair<phandle_map_t[Config::PHANDLES ? MAX_NODES_COUNT : 1],
+                    size_t>
+      phandle_maps_t;
   phandle_maps_t phandle_maps;
+  /// 倒排索引的长度，每个节点一位
+  static constexpr const size_t SET_WORDS = (MAX_NODES_COUNT + 63) / 64;
+  /// device_type = "memory" 的节点，关闭 INVERTED_INDEXES 时只保留一项
+  uint64_t memory_nodes[Config::INVERTED_INDEXES ? SET_WORDS : 1];
+  /// status = "okay" 的节点，关闭 INVERTED_INDEXES 时只保留一项
+  uint64_t okay_nodes[Config::INVERTED_INDEXES ? SET_WORDS : 1];
 
   /// dtb_iter 回调函数类型
   typedef bool (*callback_func_t)(nodes_t& _nodes, phandle_maps_t&,
                                   const iter_data_t&, void*);
 
+  /// 子树哈希的初始值，64 位 FNV-1a offset basis
+  static constexpr const uint64_t HASH_SEED = 0xCBF29CE484222325ULL;
+
+  /**
+   * @brief 64 位 FNV-1a
+   * @param  _data           数据
+   * @param  _len            数据长度
+   * @param  _hash           初始值
+   * @return uint64_t        哈希
+   */
+  static uint64_t hash_bytes(const void* _data, size_t _len, uint64_t _hash) {
+    for (size_t i = 0; i < _len; i++) {
+      _hash = (_hash ^ ((const uint8_t*)_data)[i]) * 0x100000001B3ULL;
+    }
+    return _hash;
+  }
+
+  /**
+   * @brief splitmix64 的混合函数，使每一位都影响结果
+   * @param  _x              输入
+   * @return uint64_t        混合后的值
+   */
+  static uint64_t hash_mix(uint64_t _x) {
+    _x = (_x ^ (_x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    _x = (_x ^ (_x >> 27)) * 0x94D049BB133111EBULL;
+    return _x ^ (_x >> 31);
+  }
+
+  /**
+   * @brief 按顺序合并哈希
+   * @param  _acc            已合并的哈希
+   * @param  _hash           要合并的哈希
+   * @return uint64_t        合并结果
+   */
+  static uint64_t hash_fold(uint64_t _acc, uint64_t _hash) {
+    _hash += 0x9E3779B97F4A7C15ULL + (_acc << 6) + (_acc >> 2);
+    return hash_mix(_acc ^ _hash);
+  }
+
+  /**
+   * @brief 节点名的哈希，也是子树哈希的起点
+   * @param  _name           节点名
+   * @return uint64_t        哈希
+   */
+  static uint64_t hash_node_name(const char* _name) {
+    return hash_bytes(_name, fdt_strlen(_name) + 1, HASH_SEED);
+  }
+
+  /**
+   * @brief 属性的哈希，包括属性名与属性值
+   * @param  _name           属性名
+   * @param  _data           属性值
+   * @param  _len            属性值长度
+   * @return uint64_t        哈希
+   */
+  static uint64_t hash_prop(const char* _name, const void* _data,
+                            size_t _len) {
+    return hash_mix(hash_bytes(
+        _data, _len, hash_bytes(_name, fdt_strlen(_name) + 1, HASH_SEED)));
+  }
+
+  /**
+   * @brief 将结束的子节点合并到父节点，取反以区分属性
+   * @param  _acc            父节点已合并的哈希
+   * @param  _child          子节点的子树哈希
+   * @return uint64_t        合并结果
+   */
+  static uint64_t hash_fold_child(uint64_t _acc, uint64_t _child) {
+    return hash_fold(_acc, ~_child);
+  }
+
   /**
    * @brief 查找 _prop_name 在 dt_fmt_t 的索引
    * @param  _prop_name      要查找的属性
    * @return dt_fmt_t        在 dt_fmt_t 中的索引
    */
-  dt_fmt_t get_fmt(const char* _prop_name) {
+  static dt_fmt_t get_fmt(const char* _prop_name) {
     // 默认为 FMT_UNKNOWN
     dt_fmt_t res = FMT_UNKNOWN;
     for (size_t i = 0; i < sizeof(props) / sizeof(dt_prop_fmt_t); i++) {
@@ -417,11 +981,41 @@ class fdt_parser final {
     return res;
   }
 
+  /// str_len() 没有找到 '\0'
+  static constexpr const size_t NO_STR = (size_t)-1;
+
+  /**
+   * @brief 区域是否在 dtb 内
+   * @param  _off            区域偏移
+   * @param  _len            区域长度
+   * @param  _total          dtb 总长度
+   * @return true            是
+   * @return false           否
+   */
+  static bool in_blob(uint32_t _off, uint32_t _len, uint32_t _total) {
+    return _off <= _total && _len <= _total - _off;
+  }
+
+  /**
+   * @brief 在 _max 个字符内计算字符串长度
+   * @param  _s              字符串
+   * @param  _max            最多读取的字符数
+   * @return size_t          长度，_max 个字符内没有 '\0' 时为 NO_STR
+   */
+  static size_t str_len(const char* _s, size_t _max) {
+    for (size_t i = 0; i < _max; i++) {
+      if (_s[i] == '\0') {
+        return i;
+      }
+    }
+    return NO_STR;
+  }
+
   /**
    * @brief 输出 reserved 内存
    */
   void dtb_mem_reserved(void) {
-    fdt_reserve_entry_t* entry = dtb_info.reserved;
+    auto entry = (fdt_reserve_entry_t*)(dtb_info.base + dtb_info.reserved);
     if (entry->addr_le || entry->size_le) {
       // 目前没有考虑这种情况，先报错
       fdt_parser_assert(0);
@@ -491,8 +1085,8 @@ class fdt_parser final {
         }
         case FDT_PROP: {
           iter.prop_len = fdt_parser_be32toh(iter.addr[1]);
-          iter.prop_name =
-              (char*)(dtb_info.str + fdt_parser_be32toh(iter.addr[2]));
+          iter.prop_name = (char*)(dtb_info.base + dtb_info.str +
+                                   fdt_parser_be32toh(iter.addr[2]));
           iter.prop_addr = iter.addr + 3;
           if (_cb_flags & DT_ITER_PROP) {
             if (_cb(nodes, phandle_maps, iter, _data)) {
@@ -527,85 +1121,157 @@ class fdt_parser final {
   /**
    * @brief 查找 phandle 映射
    * @param  _phandle        要查找的 phandle
-   * @return node_t*         _phandle 指向的节点
+   * @return uint32_t        _phandle 指向的节点下标，未找到时为 NO_NODE
    */
-  node_t* get_phandle(uint32_t _phandle) {
+  uint32_t get_phandle(uint32_t _phandle) const {
+    static_assert(Config::PHANDLES, "phandles are disabled in Config");
     // 在 phandle_map 中寻找对应的节点
     for (size_t i = 0; i < phandle_maps.second; i++) {
       if (phandle_maps.first[i].phandle == _phandle) {
         return phandle_maps.first[i].node;
       }
     }
-    return nullptr;
+    return NO_NODE;
   }
 
   /**
-   * @brief 初始化节点
-   * @param  _iter           迭代变量
-   * @param  _data           数据，未使用
-   * @return true            成功
-   * @return false           失败
+   * @brief 设置新节点的默认值与父节点、兄弟节点
+   * @param  _nodes          节点数组
+   * @param  _idx            节点下标
+   * @param  _off            FDT_BEGIN_NODE 相对 dtb 头的偏移
+   * @param  _depth          路径深度，根节点为 1
    */
-  static bool dtb_init_cb(nodes_t& _nodes, phandle_maps_t& _phandle_maps,
-                          const iter_data_t& _iter, void*) {
-    // 索引
-    size_t idx = _iter.nodes_idx;
-    // 根据类型
-    switch (_iter.type) {
-      // 开始
-      case FDT_BEGIN_NODE: {
-        // 设置节点基本信息
-        _nodes.first[idx].path = _iter.path;
-        _nodes.first[idx].addr = _iter.addr;
-        _nodes.first[idx].depth = _iter.path.len;
-        // 设置默认值
-        _nodes.first[idx].address_cells = 2;
-        _nodes.first[idx].size_cells = 2;
-        _nodes.first[idx].interrupt_cells = 0;
-        _nodes.first[idx].phandle = 0;
-        _nodes.first[idx].interrupt_parent = nullptr;
-        // 设置父节点
-        // 如果不是根节点
-        if (idx != 0) {
-          size_t i = idx - 1;
-          while (_nodes.first[i].depth != _nodes.first[idx].depth - 1) {
-            i--;
-          }
-          _nodes.first[idx].parent = &_nodes.first[i];
-        }
-        // 索引为 0 说明是根节点
-        else {
-          // 根节点的父节点为空
-          _nodes.first[idx].parent = nullptr;
+  static void init_node(nodes_t& _nodes, size_t _idx, uint32_t _off,
+                        size_t _depth) {
+    init_node_info(_nodes, _idx, _off, _depth);
+    // 设置父节点
+    // 如果不是根节点
+    if (_idx != 0) {
+      size_t i = _idx - 1;
+      while (_nodes.first[i].depth != _nodes.first[_idx].depth - 1) {
+        // 向前遇到的第一个同深度节点是上一个兄弟节点
+        if constexpr (Config::SIBLINGS) {
+          if (_nodes.first[i].depth == _nodes.first[_idx].depth &&
+              _nodes.first[i].sibling == NO_NODE) {
+            _nodes.first[i].sibling = _idx;
+          }
         }
+        i--;
+      }
+      _nodes.first[_idx].parent = i;
+    }
+    // 索引为 0 说明是根节点
+    else {
+      // 根节点的父节点为空
+      _nodes.first[_idx].parent = NO_NODE;
+    }
+    return;
+  }
+
+  /**
+   * @brief 设置新节点的默认值，不设置父节点与兄弟节点
+   * @param  _nodes          节点数组
+   * @param  _idx            节点下标
+   * @param  _off            FDT_BEGIN_NODE 相对 dtb 头的偏移
+   * @param  _depth          路径深度，根节点为 1
+   */
+  static void init_node_info(nodes_t& _nodes, size_t _idx, uint32_t _off,
+                             size_t _depth) {
+    // 设置节点基本信息
+    _nodes.first[_idx].off = _off;
+    _nodes.first[_idx].depth = _depth;
+    _nodes.first[_idx].prop_count = 0;
+    // 设置默认值
+    _nodes.first[_idx].address_cells = 2;
+    _nodes.first[_idx].size_cells = 2;
+    _nodes.first[_idx].interrupt_cells = 0;
+    _nodes.first[_idx].phandle = 0;
+    if constexpr (Config::INTERRUPT_PARENTS) {
+      _nodes.first[_idx].interrupt_parent = NO_NODE;
+    }
+    if constexpr (Config::SIBLINGS) {
+      _nodes.first[_idx].sibling = NO_NODE;
+    }
+    return;
+  }
+
+  /**
+   * @brief 根据属性名设置节点的 cells 与 phandle 信息
+   * @param  _nodes          节点数组
+   * @param  _phandle_maps   phandle 数组
+   * @param  _idx            节点下标
+   * @param  _name           属性名
+   * @param  _data           属性数据
+   */
+  static void init_prop_info(nodes_t& _nodes, phandle_maps_t& _phandle_maps,
+                             size_t _idx, const char* _name,
+                             const uint32_t* _data) {
+    // 获取 cells 信息
+    if (fdt_strcmp(_name, "#address-cells") == 0) {
+      _nodes.first[_idx].address_cells = fdt_parser_be32toh(_data[0]);
+    } else if (fdt_strcmp(_name, "#size-cells") == 0) {
+      _nodes.first[_idx].size_cells = fdt_parser_be32toh(_data[0]);
+    } else if (fdt_strcmp(_name, "#interrupt-cells") == 0) {
+      _nodes.first[_idx].interrupt_cells = fdt_parser_be32toh(_data[0]);
+    }
+    // phandle 信息
+    else if (fdt_strcmp(_name, "phandle") == 0) {
+      _nodes.first[_idx].phandle = fdt_parser_be32toh(_data[0]);
+      // 更新 phandle_map
+      if constexpr (Config::PHANDLES) {
+        _phandle_maps.first[_phandle_maps.second].phandle =
+            _nodes.first[_idx].phandle;
+        _phandle_maps.first[_phandle_maps.second].node = _idx;
+        _phandle_maps.second++;
+      }
+    }
+    return;
+  }
+
+  /**
+   * @brief 在节点末尾添加属性
+   * @param  _nodes          节点数组
+   * @param  _idx            节点下标
+   * @param  _nameoff        属性名相对字符区的偏移
+   * @param  _off            属性数据相对 dtb 头的偏移
+   * @param  _len            属性长度
+   */
+  static void add_prop(nodes_t& _nodes, size_t _idx, uint32_t _nameoff,
+                       uint32_t _off, uint32_t _len) {
+    auto& node = _nodes.first[_idx];
+    node.props[node.prop_count].nameoff = _nameoff;
+    node.props[node.prop_count].off = _off;
+    node.props[node.prop_count].len = _len;
+    node.prop_count++;
+    return;
+  }
+
+  /**
+   * @brief 初始化节点
+   * @param  _iter           迭代变量
+   * @param  _data           dtb_info_t，用于计算偏移
+   * @return true            成功
+   * @return false           失败
+   */
+  static bool dtb_init_cb(nodes_t& _nodes, phandle_maps_t& _phandle_maps,
+                          const iter_data_t& _iter, void* _data) {
+    auto base = ((dtb_info_t*)_data)->base;
+    // 索引
+    size_t idx = _iter.nodes_idx;
+    // 根据类型
+    switch (_iter.type) {
+      // 开始
+      case FDT_BEGIN_NODE: {
+        init_node(_nodes, idx, (uintptr_t)_iter.addr - base, _iter.path.len);
         break;
       }
       case FDT_PROP: {
-        // 获取 cells 信息
-        if (fdt_strcmp(_iter.prop_name, "#address-cells") == 0) {
-          _nodes.first[idx].address_cells = fdt_parser_be32toh(_iter.addr[3]);
-        } else if (fdt_strcmp(_iter.prop_name, "#size-cells") == 0) {
-          _nodes.first[idx].size_cells = fdt_parser_be32toh(_iter.addr[3]);
-        } else if (fdt_strcmp(_iter.prop_name, "#interrupt-cells") == 0) {
-          _nodes.first[idx].interrupt_cells = fdt_parser_be32toh(_iter.addr[3]);
-        }
-        // phandle 信息
-        else if (fdt_strcmp(_iter.prop_name, "phandle") == 0) {
-          _nodes.first[idx].phandle = fdt_parser_be32toh(_iter.addr[3]);
-          // 更新 phandle_map
-          _phandle_maps.first[_phandle_maps.second].phandle =
-              _nodes.first[idx].phandle;
-          _phandle_maps.first[_phandle_maps.second].node = &_nodes.first[idx];
-          _phandle_maps.second++;
-        }
+        init_prop_info(_nodes, _phandle_maps, idx, _iter.prop_name,
+                       _iter.addr + 3);
         // 添加属性
-        _nodes.first[idx].props[_nodes.first[idx].prop_count].name =
-            _iter.prop_name;
-        _nodes.first[idx].props[_nodes.first[idx].prop_count].addr =
-            (uintptr_t)(_iter.addr + 3);
-        _nodes.first[idx].props[_nodes.first[idx].prop_count].len =
-            fdt_parser_be32toh(_iter.addr[1]);
-        _nodes.first[idx].prop_count++;
+        add_prop(_nodes, idx, fdt_parser_be32toh(_iter.addr[2]),
+                 (uintptr_t)(_iter.addr + 3) - base,
+                 fdt_parser_be32toh(_iter.addr[1]));
         break;
       }
       case FDT_END_NODE: {
@@ -628,159 +1294,334 @@ class fdt_parser final {
   static bool dtb_init_interrupt_cb(nodes_t& _nodes,
                                     phandle_maps_t& _phandle_maps,
                                     const iter_data_t& _iter, void*) {
-    uint8_t idx = _iter.nodes_idx;
-    uint32_t phandle;
-    node_t* parent = nullptr;
     // 设置中断父节点
     if (fdt_strcmp(_iter.prop_name, "interrupt-parent") == 0) {
-      phandle = fdt_parser_be32toh(_iter.addr[3]);
-      // parent = get_phandle(phandle);
-      for (size_t i = 0; i < _phandle_maps.second; i++) {
-        if (_phandle_maps.first[i].phandle == phandle) {
-          parent = _phandle_maps.first[i].node;
-        }
-      }
-      // 没有找到则报错
-      fdt_parser_assert(parent != nullptr);
-      _nodes.first[idx].interrupt_parent = parent;
+      init_interrupt_parent(_nodes, _phandle_maps, _iter.nodes_idx,
+                            fdt_parser_be32toh(_iter.addr[3]));
     }
     // 返回 false 表示需要迭代全部节点
     return false;
   }
 
   /**
-   * @brief 填充 resource_t
-   * @param  _resource       被填充的
-   * @param  _node           源节点
-   * @param  _prop           填充的数据
+   * @brief 设置中断父节点
+   * @param  _nodes          节点数组
+   * @param  _phandle_maps   phandle 数组
+   * @param  _idx            节点下标
+   * @param  _phandle        interrupt-parent 的值
    */
-  void fill_resource(resource_t& _resource, const node_t& _node,
-                     const prop_t& _prop) {
-    // 如果 _resource 名称为空则使用 compatible，如果没有找到则使用 _node 路径
-    if (_resource.name == nullptr) {
-      for (size_t i = 0; i < _node.prop_count; i++) {
-        if (fdt_strcmp(_node.props[i].name, "compatible") == 0) {
-          _resource.name = (char*)_node.props[i].addr;
-        }
-        if (_resource.name == nullptr) {
-          _resource.name = _node.path.path[_node.path.len - 1];
-        }
+  static void init_interrupt_parent(nodes_t& _nodes,
+                                    const phandle_maps_t& _phandle_maps,
+                                    size_t _idx, uint32_t _phandle) {
+    uint32_t parent = NO_NODE;
+    // parent = get_phandle(phandle);
+    for (size_t i = 0; i < _phandle_maps.second; i++) {
+      if (_phandle_maps.first[i].phandle == _phandle) {
+        parent = _phandle_maps.first[i].node;
       }
     }
-    // 内存类型
-    if ((_resource.type & resource_t::MEM) && (_resource.mem.len == 0)) {
-      // 根据 address_cells 与 size_cells 填充
-      // resource 一般来说两者是相等的
-      if (_node.parent->address_cells == 1) {
-        fdt_parser_assert(_node.parent->size_cells == 1);
-        _resource.mem.addr = fdt_parser_be32toh(((uint32_t*)_prop.addr)[0]);
-        _resource.mem.len = fdt_parser_be32toh(((uint32_t*)_prop.addr)[1]);
-      } else if (_node.parent->address_cells == 2) {
-        fdt_parser_assert(_node.parent->size_cells == 2);
-        _resource.mem.addr = fdt_parser_be32toh(((uint32_t*)_prop.addr)[0]) +
-                             fdt_parser_be32toh(((uint32_t*)_prop.addr)[1]);
-        _resource.mem.len = fdt_parser_be32toh(((uint32_t*)_prop.addr)[2]) +
-                            fdt_parser_be32toh(((uint32_t*)_prop.addr)[3]);
-      } else {
-        fdt_parser_assert(0);
+    // 没有找到则报错
+    fdt_parser_assert(parent != NO_NODE);
+    _nodes.first[_idx].interrupt_parent = parent;
+    return;
+  }
+
+  /**
+   * @brief 计算所有节点的子树哈希
+   * @note 节点按先序排列，用栈保存尚未结束的节点，节点结束时将其哈希按顺序
+   * 合并到父节点，与 blob_hash() 的结果一致
+   */
+  void dtb_init_hash(void) {
+    hash_subtree(0, nodes.second);
+    return;
+  }
+
+  /**
+   * @brief 节点名与属性的哈希，子节点之前的部分
+   * @param  _node           节点
+   * @return uint64_t        尚未合并子节点的哈希
+   */
+  uint64_t hash_node_head(const node_t& _node) const {
+    auto res = hash_node_name(node_name(_node));
+    for (size_t j = 0; j < _node.prop_count; j++) {
+      res = hash_fold(res, hash_prop(prop_name(_node.props[j]),
+                                     (const void*)prop_addr(_node.props[j]),
+                                     _node.props[j].len));
+    }
+    return res;
+  }
+
+  /**
+   * @brief 计算一棵子树中所有节点的哈希
+   * @param  _begin          子树根节点下标
+   * @param  _end            子树之后的第一个节点下标
+   */
+  void hash_subtree(size_t _begin, size_t _end) {
+    // 尚未结束的节点，open[k] 的深度为 open[0] 的深度 + k
+    uint32_t open[MAX_DEPTH];
+    uint64_t acc[MAX_DEPTH];
+    size_t top = 0;
+    size_t base = nodes.first[_begin].depth;
+    for (size_t i = _begin; i <= _end; i++) {
+      // 最后结束子树中的所有节点
+      size_t depth = (i < _end) ? nodes.first[i].depth : base;
+      // 结束深度不小于当前节点的节点
+      while (top > depth - base) {
+        top--;
+        auto hash = hash_mix(acc[top]);
+        nodes.first[open[top]].hash = hash;
+        if (top > 0) {
+          acc[top - 1] = hash_fold_child(acc[top - 1], hash);
+        }
       }
-    } else if (_resource.type & resource_t::INTR_NO) {
-      // 中断类型
-      _resource.intr_no = fdt_parser_be32toh(((uint32_t*)_prop.addr)[0]);
-    } else if (_resource.type & resource_t::FREQUENCY) {
-      // cpu 速度类型
-      _resource.frequency = fdt_parser_be32toh(((uint32_t*)_prop.addr)[0]);
+      if (i == _end) {
+        break;
+      }
+      open[top] = i;
+      acc[top] = hash_node_head(nodes.first[i]);
+      top++;
     }
     return;
   }
 
   /**
-   * @brief 通过路径寻找节点
-   * @param  _path            路径
-   * @return node_t*          找到的节点
+   * @brief 建立倒排索引
+   * @note 与 STRING 条件的判断相同，select() 可以直接用索引代替该条件
    */
-  node_t* find_node_via_path(const char* _path) {
-    node_t* res = nullptr;
-    // 遍历 nodes
+  void dtb_init_inverted(void) {
+    for (size_t w = 0; w < SET_WORDS; w++) {
+      memory_nodes[w] = 0;
+      okay_nodes[w] = 0;
+    }
     for (size_t i = 0; i < nodes.second; i++) {
-      // 如果 nodes[i] 中有属性/值对符合要求
-      if (nodes.first[i].path == _path) {
-        // 设置返回值
-        res = &nodes.first[i];
+      inverted_node(i);
+    }
+    return;
+  }
+
+  /**
+   * @brief 根据节点的属性设置其在倒排索引中的位，调用前应已清除
+   * @param  _idx            节点下标
+   */
+  void inverted_node(size_t _idx) {
+    const node_t& node = nodes.first[_idx];
+    for (size_t j = 0; j < node.prop_count; j++) {
+      auto name = prop_name(node.props[j]);
+      if (name[0] == 'd' && fdt_strcmp(name, "device_type") == 0 &&
+          prop_has_string(node.props[j], "memory")) {
+        memory_nodes[_idx / 64] |= 1ULL << (_idx % 64);
+      } else if (name[0] == 's' && fdt_strcmp(name, "status") == 0 &&
+                 prop_has_string(node.props[j], "okay")) {
+        okay_nodes[_idx / 64] |= 1ULL << (_idx % 64);
       }
     }
-    return res;
+    return;
   }
 
- public:
-  // 用于控制处理哪些属性
-  /// 处理节点开始
-  static constexpr const uint8_t DT_ITER_BEGIN_NODE = 0x01;
-  /// 处理节点结束
-  static constexpr const uint8_t DT_ITER_END_NODE = 0x02;
-  /// 处理节点属性
-  static constexpr const uint8_t DT_ITER_PROP = 0x04;
+  /**
+   * @brief 比较两个属性的值
+   * @param  _other          _new 所在的索引
+   * @param  _old            本索引中的属性
+   * @param  _new            _other 中的属性
+   * @return true            相同
+   * @return false           不同
+   */
+  bool prop_equal(const basic_fdt_index& _other, const prop_t& _old,
+                  const prop_t& _new) const {
+    if (_old.len != _new.len) {
+      return false;
+    }
+    auto old_data = (const uint8_t*)prop_addr(_old);
+    auto new_data = (const uint8_t*)_other.prop_addr(_new);
+    for (size_t i = 0; i < _old.len; i++) {
+      if (old_data[i] != new_data[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
 
   /**
-   * 构造函数
-   * @param _dtb_addr dtb 信息地址
+   * @brief 递归比较两个节点，只进入哈希不同的子树
+   * @param  _other          新索引
+   * @param  _old            本索引中的节点下标
+   * @param  _new            _other 中的节点下标
+   * @param  _cb             差异回调，可以为 nullptr
+   * @param  _data           要传递的数据
+   * @return size_t          差异数
+   */
+  size_t diff_node(const basic_fdt_index& _other, uint32_t _old,
+                   uint32_t _new, diff_callback_t _cb, void* _data) const {
+    const node_t& old_node = nodes.first[_old];
+    const node_t& new_node = _other.nodes.first[_new];
+    // 哈希相同的子树没有差异
+    if constexpr (Config::HASHES) {
+      if ((init_flags & _other.init_flags & DT_INIT_HASH) &&
+          old_node.hash == new_node.hash) {
+        return 0;
+      }
+    }
+    size_t res = 0;
+    diff_t diff;
+    diff.old_node = _old;
+    diff.new_node = _new;
+    // 比较属性
+    for (size_t i = 0; i < old_node.prop_count; i++) {
+      diff.old_prop = &old_node.props[i];
+      diff.new_prop = _other.get_prop(new_node, prop_name(old_node.props[i]));
+      if (diff.new_prop == nullptr) {
+        diff.type = diff_t::PROP_REMOVED;
+      } else if (!prop_equal(_other, *diff.old_prop, *diff.new_prop)) {
+        diff.type = diff_t::PROP_CHANGED;
+      } else {
+        continue;
+      }
+      if (_cb != nullptr) {
+        _cb(diff, _data);
+      }
+      res++;
+    }
+    for (size_t i = 0; i < new_node.prop_count; i++) {
+      if (get_prop(old_node, _other.prop_name(new_node.props[i])) != nullptr) {
+        continue;
+      }
+      diff.type = diff_t::PROP_ADDED;
+      diff.old_prop = nullptr;
+      diff.new_prop = &new_node.props[i];
+      if (_cb != nullptr) {
+        _cb(diff, _data);
+      }
+      res++;
+    }
+    // 按节点名匹配子节点
+    diff.old_prop = nullptr;
+    diff.new_prop = nullptr;
+    for (auto i = first_child(_old); i != NO_NODE; i = nodes.first[i].sibling) {
+      auto j = _other.find_child(_new, node_name(nodes.first[i]));
+      if (j != NO_NODE) {
+        res += diff_node(_other, i, j, _cb, _data);
+        continue;
+      }
+      diff.type = diff_t::NODE_REMOVED;
+      diff.old_node = i;
+      diff.new_node = _new;
+      if (_cb != nullptr) {
+        _cb(diff, _data);
+      }
+      res++;
+    }
+    for (auto j = _other.first_child(_new); j != NO_NODE;
+         j = _other.nodes.first[j].sibling) {
+      if (find_child(_old, _other.node_name(_other.nodes.first[j])) !=
+          NO_NODE) {
+        continue;
+      }
+      diff.type = diff_t::NODE_ADDED;
+      diff.old_node = _old;
+      diff.new_node = j;
+      if (_cb != nullptr) {
+        _cb(diff, _data);
+      }
+      res++;
+    }
+    return res;
+  }
+
+  /**
+   * @brief 使已有的索引指向另一份相同的 dtb
+   * @param _validated        validate() 的结果
+   * @return true             成功
+   * @return false            没有子树哈希，或 dtb 的布局与哈希不同
+   * @note 用于复用缓存的索引，头信息中的偏移与长度以及根哈希都相同时布局相同
    */
-  explicit fdt_parser(uintptr_t _dtb_addr) { dtb_init(_dtb_addr); }
+  bool rebase(const fdt_validated_t& _validated) {
+    static_assert(Config::HASHES, "hashes are disabled in Config");
+    auto header = (const fdt_header_t*)_validated.dtb_addr();
+    if (!(init_flags & DT_INIT_HASH) || !_validated.valid() ||
+        fdt_parser_be32toh(header->totalsize) != dtb_info.size ||
+        fdt_parser_be32toh(header->off_mem_rsvmap) != dtb_info.reserved ||
+        fdt_parser_be32toh(header->off_dt_struct) != dtb_info.data ||
+        fdt_parser_be32toh(header->off_dt_strings) != dtb_info.str ||
+        blob_hash(_validated) != root_hash()) {
+      return false;
+    }
+    dtb_info.base = _validated.dtb_addr();
+    return true;
+  }
 
-  /// @name 默认构造/析构函数
-  /// @{
-  fdt_parser() = default;
-  fdt_parser(const fdt_parser& _fdt_parser) = default;
-  fdt_parser(fdt_parser&& _fdt_parser) = default;
-  auto operator=(const fdt_parser& _fdt_parser) -> fdt_parser& = default;
-  auto operator=(fdt_parser&& _fdt_parser) -> fdt_parser& = default;
-  ~fdt_parser() = default;
-  /// @}
+  /**
+   * @brief 使已有的索引指向另一份相同的 dtb
+   * @param _dtb_addr         dtb 二进制信息地址
+   * @return true             成功
+   * @return false            dtb 格式错误，或与索引不同
+   */
+  bool rebase(uintptr_t _dtb_addr) {
+    fdt_validated_t validated;
+    if (!validate(_dtb_addr, validated)) {
+      return false;
+    }
+    return rebase(validated);
+  }
 
   /**
-   * @brief 初始化
-   * @param _dtb_addr dtb 二进制信息地址
+   * @brief 初始化已检查的 dtb，不再检查边界
+   * @param _validated       validate() 的结果
+   * @param _flags           DT_INIT_* 标志
    * @return true            成功
-   * @return false           失败
+   * @return false           超出索引容量
    */
-
-  bool dtb_init(uintptr_t _dtb_addr) {
+  bool dtb_init(const fdt_validated_t& _validated, uint8_t _flags = 0) {
+    nodes.second = 0;
+    phandle_maps.second = 0;
+    init_flags = 0;
+    if (!_validated.fits<Config>()) {
+      return false;
+    }
+    auto header = (const fdt_header_t*)_validated.dtb_addr();
     // 头信息
-    dtb_info.header = (fdt_header_t*)_dtb_addr;
-    // 魔数
-    fdt_parser_assert(fdt_parser_be32toh(dtb_info.header->magic) == FDT_MAGIC);
-    // 版本
-    fdt_parser_assert(fdt_parser_be32toh(dtb_info.header->version) ==
-                      FDT_VERSION);
+    dtb_info.base = _validated.dtb_addr();
+    dtb_info.size = fdt_parser_be32toh(header->totalsize);
+    init_flags = Config::HASHES ? _flags : (_flags & ~DT_INIT_HASH);
     // 内存保留区
-    dtb_info.reserved =
-        (fdt_reserve_entry_t*)(_dtb_addr +
-                               fdt_parser_be32toh(
-                                   dtb_info.header->off_mem_rsvmap));
+    dtb_info.reserved = fdt_parser_be32toh(header->off_mem_rsvmap);
     // 数据区
-    dtb_info.data =
-        _dtb_addr + fdt_parser_be32toh(dtb_info.header->off_dt_struct);
+    dtb_info.data = fdt_parser_be32toh(header->off_dt_struct);
+    dtb_info.data_size = fdt_parser_be32toh(header->size_dt_struct);
     // 字符区
-    dtb_info.str =
-        _dtb_addr + fdt_parser_be32toh(dtb_info.header->off_dt_strings);
+    dtb_info.str = fdt_parser_be32toh(header->off_dt_strings);
+    dtb_info.str_size = fdt_parser_be32toh(header->size_dt_strings);
     // 检查保留内存
     dtb_mem_reserved();
     // 初始化节点的基本信息
     dtb_iter(DT_ITER_BEGIN_NODE | DT_ITER_END_NODE | DT_ITER_PROP, dtb_init_cb,
-             nullptr, dtb_info.data);
+             &dtb_info, dtb_info.base + dtb_info.data);
     // 中断信息初始化，因为需要查找 phandle，所以在基本信息初始化完成后进行
-    dtb_iter(DT_ITER_PROP, dtb_init_interrupt_cb, nullptr, dtb_info.data);
+    if constexpr (Config::INTERRUPT_PARENTS) {
+      dtb_iter(DT_ITER_PROP, dtb_init_interrupt_cb, nullptr,
+               dtb_info.base + dtb_info.data);
+    }
+    // 子树哈希
+    if constexpr (Config::HASHES) {
+      if (init_flags & DT_INIT_HASH) {
+        dtb_init_hash();
+      }
+    }
+    // 倒排索引
+    if constexpr (Config::INVERTED_INDEXES) {
+      dtb_init_inverted();
+    }
 // #define DEBUG
 #ifdef DEBUG
     // 输出所有信息
     for (size_t i = 0; i < nodes.second; i++) {
-      fdt_parser_printf("%s:\n", nodes.first[i].path);
+      fdt_parser_printf("%s:\n", node_name(nodes.first[i]));
       for (size_t j = 0; j < nodes.first[i].prop_count; j++) {
-        fdt_parser_printf("%s: ", nodes.first[i].props[j].name);
+        fdt_parser_printf("%s: ", prop_name(nodes.first[i].props[j]));
         for (size_t k = 0; k < nodes.first[i].props[j].len / 4; k++) {
           fdt_parser_printf(
               "0x%X ",
-              fdt_parser_be32toh(((uint32_t*)nodes.first[i].props[j].addr)[k]));
+              fdt_parser_be32toh(
+                  ((uint32_t*)prop_addr(nodes.first[i].props[j]))[k]));
         }
         fdt_parser_printf("\n");
       }
@@ -790,72 +1631,2677 @@ class fdt_parser final {
   }
 
   /**
-   * @brief 根据路径查找节点，返回使用的资源
-   * @param  _path            节点路径
-   * @param  _resource        资源
-   * @return true             成功
-   * @return false            失败
+   * @brief 检查并初始化
+   * @param _dtb_addr dtb 二进制信息地址
+   * @param _flags           DT_INIT_* 标志
+   * @return true            成功
+   * @return false           dtb 格式错误或超出索引容量
    */
-  bool find_via_path(const char* _path, resource_t* _resource) {
-    // 找到节点
-    auto node = find_node_via_path(_path);
-    // 找到 reg
-    for (size_t i = 0; i < node->prop_count; i++) {
-      // fdt_parser_printf("node->props[i].name: %s\n", node->props[i].name);
-      if (fdt_strcmp(node->props[i].name, "reg") == 0) {
-        // 填充数据
-        _resource->type |= resource_t::MEM;
-        fill_resource(_resource[0], *node, node->props[i]);
-      } else if (fdt_strcmp(node->props[i].name, "interrupts") == 0) {
-        // 填充数据
-        _resource->type |= resource_t::INTR_NO;
-        fill_resource(_resource[0], *node, node->props[i]);
+  bool dtb_init(uintptr_t _dtb_addr, uint8_t _flags = 0) {
+    fdt_validated_t validated;
+    auto res = validate(_dtb_addr, validated);
+    fdt_parser_assert(res);
+    if (!res) {
+      nodes.second = 0;
+      phandle_maps.second = 0;
+      init_flags = 0;
+      return false;
+    }
+    return dtb_init(validated, _flags);
+  }
+
+  /**
+   * @brief 开始增量建立索引，用于边解压边建立索引
+   * @param  _stream         增量状态
+   * @param  _dtb_addr       dtb 将被写入的缓冲区地址
+   * @param  _size           缓冲区长度
+   * @note 之后每写入一部分数据调用一次 stream_feed()，全部写入后调用
+   * stream_finish()，在此之前索引为空
+   */
+  void stream_begin(stream_t& _stream, uintptr_t _dtb_addr, size_t _size) {
+    nodes.second = 0;
+    phandle_maps.second = 0;
+    init_flags = 0;
+    dtb_info.base = _dtb_addr;
+    _stream.stage = stream_t::STAGE_HEADER;
+    _stream.size = _size;
+    _stream.avail = 0;
+    _stream.pos = 0;
+    _stream.depth = 0;
+    _stream.nodes_count = 0;
+    _stream.props_count = 0;
+    _stream.reserved_done = false;
+    _stream.root_done = false;
+    _stream.after_child = false;
+    _stream.overflow = false;
+    return;
+  }
+
+  /**
+   * @brief 处理新写入的数据
+   * @param  _stream         增量状态
+   * @param  _avail          缓冲区开始处已经写入的总长度
+   * @return true            成功，数据不完整的 token 留到下一次处理
+   * @return false           dtb 格式错误
+   * @note 与 validate() 进行相同的检查，数据区中的节点与属性在数据到达时
+   * 立即加入索引，属性名在 stream_finish() 中字符区到达后再解析
+   */
+  bool stream_feed(stream_t& _stream, size_t _avail) {
+    auto base = dtb_info.base;
+    _stream.avail = (_avail < _stream.size) ? _avail : _stream.size;
+    if (_stream.stage == stream_t::STAGE_HEADER) {
+      if (_stream.avail < sizeof(fdt_header_t)) {
+        return true;
+      }
+      auto header = (const fdt_header_t*)base;
+      auto data = fdt_parser_be32toh(header->off_dt_struct);
+      _stream.total = fdt_parser_be32toh(header->totalsize);
+      _stream.reserved = fdt_parser_be32toh(header->off_mem_rsvmap);
+      _stream.data = data;
+      _stream.data_end = data + fdt_parser_be32toh(header->size_dt_struct);
+      _stream.str = fdt_parser_be32toh(header->off_dt_strings);
+      _stream.str_size = fdt_parser_be32toh(header->size_dt_strings);
+      if (!header_ok(header, _stream.size)) {
+        _stream.stage = stream_t::STAGE_ERROR;
+        return false;
+      }
+      _stream.reserved_pos = _stream.reserved;
+      _stream.pos = data;
+      _stream.stage = stream_t::STAGE_BODY;
+    }
+    // 保留区以全 0 的项结束
+    while (_stream.stage != stream_t::STAGE_ERROR && !_stream.reserved_done &&
+           _stream.reserved_pos + sizeof(fdt_reserve_entry_t) <=
+               _stream.avail) {
+      if (!in_blob(_stream.reserved_pos, sizeof(fdt_reserve_entry_t),
+                   _stream.total)) {
+        _stream.stage = stream_t::STAGE_ERROR;
+        break;
+      }
+      auto entry = (const fdt_reserve_entry_t*)(base + _stream.reserved_pos);
+      _stream.reserved_done = !(entry->addr_be || entry->addr_le ||
+                                entry->size_be || entry->size_le);
+      _stream.reserved_pos += sizeof(fdt_reserve_entry_t);
+    }
+    // 数据区，可以读取的部分
+    size_t limit =
+        (_stream.avail < _stream.data_end) ? _stream.avail : _stream.data_end;
+    while (_stream.stage == stream_t::STAGE_BODY) {
+      auto pos = _stream.pos;
+      if (pos + 4 > _stream.data_end) {
+        // 没有 FDT_END
+        _stream.stage = stream_t::STAGE_ERROR;
+        break;
+      }
+      if (pos + 4 > limit) {
+        break;
+      }
+      auto words = (const uint32_t*)(base + pos);
+      auto token = fdt_parser_be32toh(words[0]);
+      if (token == FDT_NOP) {
+        _stream.pos += 4;
+      } else if (token == FDT_BEGIN_NODE) {
+        if (_stream.root_done) {
+          _stream.stage = stream_t::STAGE_ERROR;
+          break;
+        }
+        auto name_len = str_len((const char*)(words + 1), limit - pos - 4);
+        if (name_len == NO_STR) {
+          // 节点名不完整
+          if (limit == _stream.data_end) {
+            _stream.stage = stream_t::STAGE_ERROR;
+          }
+          break;
+        }
+        _stream.pos += 4 + align_up_power_of_two(name_len + 1, 4);
+        _stream.depth++;
+        _stream.nodes_count++;
+        _stream.props_count = 0;
+        _stream.after_child = false;
+        _stream.overflow |= _stream.depth > MAX_DEPTH ||
+                            _stream.nodes_count > MAX_NODES_COUNT;
+        if (!_stream.overflow) {
+          init_node(nodes, _stream.nodes_count - 1, pos, _stream.depth);
+          nodes.second = _stream.nodes_count;
+        }
+      } else if (token == FDT_END_NODE) {
+        if (_stream.depth == 0) {
+          _stream.stage = stream_t::STAGE_ERROR;
+          break;
+        }
+        _stream.depth--;
+        _stream.root_done = _stream.depth == 0;
+        _stream.after_child = true;
+        _stream.pos += 4;
+      } else if (token == FDT_PROP) {
+        if (_stream.depth == 0 || _stream.after_child ||
+            pos + 12 > _stream.data_end) {
+          _stream.stage = stream_t::STAGE_ERROR;
+          break;
+        }
+        if (pos + 12 > limit) {
+          break;
+        }
+        auto len = fdt_parser_be32toh(words[1]);
+        auto nameoff = fdt_parser_be32toh(words[2]);
+        if (len > _stream.data_end - pos - 12 || nameoff >= _stream.str_size) {
+          _stream.stage = stream_t::STAGE_ERROR;
+          break;
+        }
+        // 只记录偏移，不需要等待属性数据
+        _stream.props_count++;
+        _stream.overflow |= _stream.props_count > PROP_MAX_COUNT;
+        if (!_stream.overflow) {
+          add_prop(nodes, _stream.nodes_count - 1, nameoff, pos + 12, len);
+        }
+        _stream.pos += 12 + align_up_power_of_two(len, 4);
+      } else if (token == FDT_END && _stream.root_done) {
+        _stream.stage = stream_t::STAGE_END;
+      } else {
+        _stream.stage = stream_t::STAGE_ERROR;
       }
     }
+    if (_stream.stage == stream_t::STAGE_ERROR) {
+      nodes.second = 0;
+      return false;
+    }
     return true;
   }
 
   /**
-   * @brief 根据节点名进行前缀查找
-   * @param  _prefix          要查找节点的前缀
-   * @param  _resource        结果数组
-   * @return size_t           _resource 长度
-   * @note 根据节点 @ 前的名称查找，可能返回多个 resource
+   * @brief 全部数据写入后完成索引
+   * @param  _stream         增量状态
+   * @param  _flags          DT_INIT_* 标志
+   * @return true            成功，与对同一个 dtb 调用 dtb_init() 的结果相同
+   * @return false           数据不完整、dtb 格式错误或超出索引容量
    */
-  size_t find_via_prefix(const char* _prefix, resource_t* _resource) {
-    size_t res = 0;
-    // 遍历所有节点，查找
-    // 由于 @ 均为最底层节点，所以直接比较最后一级即可
-    for (size_t i = 0; i < nodes.second; i++) {
-      if (fdt_strncmp(nodes.first[i].path.path[nodes.first[i].path.len - 1],
-                      _prefix, fdt_strlen(_prefix)) == 0) {
-        // 找到 reg
+  bool stream_finish(stream_t& _stream, uint8_t _flags = 0) {
+    auto base = dtb_info.base;
+    bool res = _stream.stage == stream_t::STAGE_END && !_stream.overflow &&
+               _stream.avail >= _stream.total && _stream.reserved_done;
+    // 属性名都在字符区内以 '\0' 结束
+    auto strings = (const char*)(base + _stream.str);
+    for (size_t i = 0; res && i < nodes.second; i++) {
+      for (size_t j = 0; res && j < nodes.first[i].prop_count; j++) {
+        const prop_t& prop = nodes.first[i].props[j];
+        auto name = strings + prop.nameoff;
+        if (str_len(name, _stream.str_size - prop.nameoff) == NO_STR ||
+            (Config::PHANDLES && phandle_maps.second == MAX_NODES_COUNT &&
+             fdt_strcmp(name, "phandle") == 0)) {
+          res = false;
+          break;
+        }
+        init_prop_info(nodes, phandle_maps, i, name,
+                       (const uint32_t*)(base + prop.off));
+      }
+    }
+    if (!res) {
+      _stream.stage = stream_t::STAGE_ERROR;
+      nodes.second = 0;
+      phandle_maps.second = 0;
+      return false;
+    }
+    dtb_info.size = _stream.total;
+    dtb_info.reserved = _stream.reserved;
+    dtb_info.data = _stream.data;
+    dtb_info.data_size = _stream.data_end - _stream.data;
+    dtb_info.str = _stream.str;
+    dtb_info.str_size = _stream.str_size;
+    init_flags = Config::HASHES ? _flags : (_flags & ~DT_INIT_HASH);
+    dtb_mem_reserved();
+    // phandle 全部找到后设置中断父节点，只读取索引
+    if constexpr (Config::INTERRUPT_PARENTS) {
+      for (size_t i = 0; i < nodes.second; i++) {
         for (size_t j = 0; j < nodes.first[i].prop_count; j++) {
-          if (fdt_strcmp(nodes.first[i].props[j].name, "reg") == 0) {
-            _resource[res].type |= resource_t::MEM;
-            // 填充数据
-            fill_resource(_resource[res], nodes.first[i],
-                          nodes.first[i].props[j]);
-          } else if (fdt_strcmp(nodes.first[i].props[j].name, "interrupts") ==
-                     0) {
-            _resource[res].type |= resource_t::INTR_NO;
-            // 填充数据
-            fill_resource(_resource[res], nodes.first[i],
-                          nodes.first[i].props[j]);
-          } else if (fdt_strcmp(nodes.first[i].props[j].name,
-                                "timebase-frequency") == 0) {
-            _resource[res].type |= resource_t::FREQUENCY;
-            // 填充数据
-            fill_resource(_resource[res], nodes.first[i],
-                          nodes.first[i].props[j]);
+          const prop_t& prop = nodes.first[i].props[j];
+          if (fdt_strcmp(strings + prop.nameoff, "interrupt-parent") == 0) {
+            init_interrupt_parent(
+                nodes, phandle_maps, i,
+                fdt_parser_be32toh(*(const uint32_t*)(base + prop.off)));
           }
         }
-        res++;
       }
     }
+    if constexpr (Config::HASHES) {
+      if (init_flags & DT_INIT_HASH) {
+        dtb_init_hash();
+      }
+    }
+    if constexpr (Config::INVERTED_INDEXES) {
+      dtb_init_inverted();
+    }
+    return true;
+  }
+
+  /**
+   * @brief dtb 被修改后只重新解析包含修改的子树
+   * @param  _dtb_addr       修改后的 dtb 地址，可以与原地址不同
+   * @param  _off            修改位置相对原数据区的偏移
+   * @param  _old_len        被替换的原数据长度
+   * @param  _new_len        替换后的数据长度
+   * @return true            成功，与对新 dtb 调用 dtb_init() 的结果相同
+   * @return false           dtb 格式错误或超出索引容量，此时索引为空
+   * @note 数据区中 [_off, _off + _old_len) 被替换为 _new_len 字节，其余内容
+   * 只随之移动，字符区只能在末尾追加，头信息与保留区可以改变
+   * @note 只重新解析包含修改的最小子树，其它节点只调整偏移与下标；修改涉及
+   * 根节点、超出子树或与新 dtb 不符，或原子树中的 phandle 多于
+   * MAX_UPDATE_PHANDLES 时调用 dtb_init() 重新建立索引
+   */
+  bool update(uintptr_t _dtb_addr, uint32_t _off, uint32_t _old_len,
+              uint32_t _new_len) {
+    auto header = (const fdt_header_t*)_dtb_addr;
+    auto old_info = dtb_info;
+    if (nodes.second == 0 ||
+        !header_ok(header, fdt_parser_be32toh(header->totalsize)) ||
+        !reserved_ok(_dtb_addr) || _off > old_info.data_size ||
+        _old_len > old_info.data_size - _off ||
+        (uint64_t)old_info.data_size - _old_len + _new_len !=
+            fdt_parser_be32toh(header->size_dt_struct) ||
+        fdt_parser_be32toh(header->size_dt_strings) < old_info.str_size) {
+      return dtb_init(_dtb_addr, init_flags);
+    }
+    dtb_info.base = _dtb_addr;
+    dtb_info.size = fdt_parser_be32toh(header->totalsize);
+    dtb_info.reserved = fdt_parser_be32toh(header->off_mem_rsvmap);
+    dtb_info.data = fdt_parser_be32toh(header->off_dt_struct);
+    dtb_info.data_size = fdt_parser_be32toh(header->size_dt_struct);
+    dtb_info.str = fdt_parser_be32toh(header->off_dt_strings);
+    dtb_info.str_size = fdt_parser_be32toh(header->size_dt_strings);
+    // 偏移的变化，按 uint32_t 回绕
+    uint32_t data_shift = dtb_info.data - old_info.data;
+    uint32_t shift = _new_len - _old_len;
+    // 只有头信息或保留区改变
+    if (_old_len == 0 && _new_len == 0) {
+      for (size_t i = 0; data_shift != 0 && i < nodes.second; i++) {
+        shift_node(nodes.first[i], data_shift);
+      }
+      dtb_mem_reserved();
+      return true;
+    }
+    // 数据区长度是 4 的倍数，将范围扩展到 token 边界
+    auto pad = _off % 4;
+    _off -= pad;
+    _old_len = align_up_power_of_two(_old_len + pad, 4);
+    _new_len = _old_len + shift;
+    auto begin = old_info.data + _off;
+    auto end = begin + _old_len;
+    // 第一个在修改位置之后开始的节点
+    size_t lo = 0;
+    size_t hi = nodes.second;
+    while (lo < hi) {
+      auto mid = (lo + hi) / 2;
+      if (nodes.first[mid].off <= begin) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    // 从包含修改的最深的节点开始，新数据不是一棵完整的子树时尝试其父节点
+    size_t next = lo;
+    for (uint32_t idx = (lo == 0) ? 0 : lo - 1; idx != 0;
+         idx = nodes.first[idx].parent) {
+      const node_t& node = nodes.first[idx];
+      while (next < nodes.second && nodes.first[next].depth > node.depth) {
+        next++;
+      }
+      // 子树到下一个节点之前结束，包括之后祖先节点的 FDT_END_NODE
+      auto span_end = (next < nodes.second)
+                          ? nodes.first[next].off
+                          : old_info.data + old_info.data_size;
+      if (begin >= span_end || end > span_end) {
+        continue;
+      }
+      size_t next_depth = 0;
+      auto new_end = dtb_info.data + dtb_info.data_size;
+      if (next < nodes.second) {
+        next_depth = nodes.first[next].depth;
+        new_end = span_end + data_shift + shift;
+      }
+      size_t count = 0;
+      size_t phandles_count = 0;
+      if (update_scan(node.off + data_shift, new_end, node.depth, next_depth,
+                      count, phandles_count) &&
+          update_subtree(idx, next, count, phandles_count, data_shift,
+                         shift)) {
+        dtb_mem_reserved();
+        return true;
+      }
+    }
+    return dtb_init(_dtb_addr, init_flags);
+  }
+
+  /**
+   * @brief dtb 中的节点被修改后只重新解析这些节点
+   * @param  _dtb_addr       修改后的 dtb 地址，可以与原地址不同
+   * @param  _nodes          被修改的节点在当前索引中的下标
+   * @param  _count          _nodes 长度，为 0 时只有头信息或保留区改变
+   * @return true            成功，与对新 dtb 调用 dtb_init() 的结果相同
+   * @return false           dtb 格式错误或超出索引容量，此时索引为空
+   * @note 修改只在这些节点的子树内，数据区长度的变化由头信息得出，有多个节点
+   * 时重新解析从第一个到最后一个子树之间的全部内容
+   */
+  bool update(uintptr_t _dtb_addr, const uint32_t* _nodes, size_t _count) {
+    uint32_t begin = dtb_info.data + dtb_info.data_size;
+    uint32_t end = dtb_info.data;
+    for (size_t i = 0; i < _count; i++) {
+      if (_nodes[i] >= nodes.second) {
+        return dtb_init(_dtb_addr, init_flags);
+      }
+      auto next = subtree_end(_nodes[i]);
+      auto span_end = (next < nodes.second)
+                          ? nodes.first[next].off
+                          : dtb_info.data + dtb_info.data_size;
+      if (nodes.first[_nodes[i]].off < begin) {
+        begin = nodes.first[_nodes[i]].off;
+      }
+      if (span_end > end) {
+        end = span_end;
+      }
+    }
+    if (_count == 0) {
+      return update(_dtb_addr, 0, 0, 0);
+    }
+    auto header = (const fdt_header_t*)_dtb_addr;
+    uint32_t old_len = end - begin;
+    uint32_t new_len = old_len + fdt_parser_be32toh(header->size_dt_struct) -
+                       dtb_info.data_size;
+    return update(_dtb_addr, begin - dtb_info.data, old_len, new_len);
+  }
+
+  /**
+   * @brief 子树之后的第一个节点
+   * @param  _idx            子树根节点下标
+   * @return uint32_t        节点下标，子树是最后一棵时为节点数
+   */
+  uint32_t subtree_end(uint32_t _idx) const {
+    auto res = _idx + 1;
+    while (res < nodes.second &&
+           nodes.first[res].depth > nodes.first[_idx].depth) {
+      res++;
+    }
     return res;
   }
-};
+
+  /**
+   * @brief 调整节点及其属性的偏移
+   * @param  _node           节点
+   * @param  _shift          偏移的变化，按 uint32_t 回绕
+   */
+  static void shift_node(node_t& _node, uint32_t _shift) {
+    _node.off += _shift;
+    for (size_t j = 0; j < _node.prop_count; j++) {
+      _node.props[j].off += _shift;
+    }
+    return;
+  }
+
+  /**
+   * @brief 检查替换子树的新数据，见 update()
+   * @param  _begin          原子树 FDT_BEGIN_NODE 相对 dtb 头的偏移
+   * @param  _end            下一个节点的 FDT_BEGIN_NODE 相对 dtb 头的偏移，
+   * 原子树是最后一棵时为数据区结束
+   * @param  _depth          原子树根节点的深度
+   * @param  _next_depth     下一个节点的深度，没有时为 0
+   * @param  _nodes_count    新数据中的节点数
+   * @param  _phandles_count 新数据中的 phandle 数
+   * @return true            范围内是任意棵同一深度的完整子树，之后只结束祖先
+   * 节点，没有子树时原子树被删除
+   * @return false           格式错误或超出索引容量
+   */
+  bool update_scan(uint32_t _begin, uint32_t _end, size_t _depth,
+                   size_t _next_depth, size_t& _nodes_count,
+                   size_t& _phandles_count) const {
+    auto words = (const uint32_t*)(dtb_info.base + _begin);
+    auto strings = (const char*)(dtb_info.base + dtb_info.str);
+    size_t count = (_end - _begin) / 4;
+    size_t pos = 0;
+    // 子树开始之前位于父节点中
+    size_t depth = _depth - 1;
+    size_t props_count = 0;
+    bool after_child = false;
+    _nodes_count = 0;
+    _phandles_count = 0;
+    while (pos < count) {
+      switch (fdt_parser_be32toh(words[pos])) {
+        case FDT_NOP: {
+          pos++;
+          break;
+        }
+        case FDT_BEGIN_NODE: {
+          // 祖先节点结束之后不能再有新节点
+          if (depth + 1 < _depth || depth >= MAX_DEPTH) {
+            return false;
+          }
+          auto name = (const char*)(words + pos + 1);
+          auto name_len = str_len(name, (count - pos - 1) * 4);
+          if (name_len == NO_STR) {
+            return false;
+          }
+          pos += 1 + align_up_power_of_two(name_len + 1, 4) / 4;
+          depth++;
+          _nodes_count++;
+          props_count = 0;
+          after_child = false;
+          break;
+        }
+        case FDT_END_NODE: {
+          if (depth == 0) {
+            return false;
+          }
+          depth--;
+          after_child = true;
+          pos++;
+          break;
+        }
+        case FDT_PROP: {
+          // 子树结束之后的属性属于祖先节点，不能出现在子节点之后
+          if (depth < _depth || after_child || count - pos < 3) {
+            return false;
+          }
+          size_t len = fdt_parser_be32toh(words[pos + 1]);
+          auto nameoff = fdt_parser_be32toh(words[pos + 2]);
+          if (len > (count - pos - 3) * 4 || nameoff >= dtb_info.str_size ||
+              props_count == PROP_MAX_COUNT) {
+            return false;
+          }
+          auto name = strings + nameoff;
+          if (str_len(name, dtb_info.str_size - nameoff) == NO_STR) {
+            return false;
+          }
+          if (fdt_strcmp(name, "phandle") == 0) {
+            _phandles_count++;
+          }
+          props_count++;
+          pos += 3 + align_up_power_of_two(len, 4) / 4;
+          break;
+        }
+        case FDT_END: {
+          // 只有最后一棵子树之后是数据区结束
+          return _next_depth == 0 && depth == 0;
+        }
+        default: {
+          return false;
+        }
+      }
+    }
+    // 结束到下一个节点的父节点
+    return _next_depth != 0 && pos == count && depth + 1 == _next_depth &&
+           fdt_parser_be32toh(words[count]) == FDT_BEGIN_NODE;
+  }
+
+  /**
+   * @brief 用新的子树替换 _idx 的子树，见 update()
+   * @param  _idx            原子树根节点下标
+   * @param  _next           原子树之后的第一个节点下标
+   * @param  _count          新子树的节点数，可以有多棵或没有
+   * @param  _phandles_count 新子树中的 phandle 数
+   * @param  _data_shift     数据区偏移的变化
+   * @param  _shift          子树长度的变化
+   * @return true            成功
+   * @return false           超出索引容量或原子树中的 phandle 多于
+   * MAX_UPDATE_PHANDLES，索引没有修改
+   * @note 新子树已由 update_scan() 检查，节点数组与 phandle 数组中子树之后
+   * 的部分整体移动一次
+   */
+  bool update_subtree(uint32_t _idx, uint32_t _next, size_t _count,
+                      size_t _phandles_count, uint32_t _data_shift,
+                      uint32_t _shift) {
+    size_t old_total = nodes.second;
+    size_t total = old_total - (_next - _idx) + _count;
+    // 原子树在 phandle 数组中的范围，phandle 按节点顺序排列
+    size_t ph_begin = phandle_lower_bound(_idx);
+    size_t ph_end = phandle_lower_bound(_next);
+    size_t ph_total = 0;
+    if constexpr (Config::PHANDLES) {
+      ph_total = phandle_maps.second - (ph_end - ph_begin) + _phandles_count;
+    }
+    // 原子树的 phandle 保存在栈上，用于判断 phandle 是否改变
+    if (total > MAX_NODES_COUNT || ph_total > MAX_NODES_COUNT ||
+        ph_end - ph_begin > MAX_UPDATE_PHANDLES) {
+      return false;
+    }
+    // 下标的变化，按 uint32_t 回绕
+    uint32_t idx_shift = total - old_total;
+    auto off = nodes.first[_idx].off + _data_shift;
+    size_t base = nodes.first[_idx].depth;
+    auto parent = nodes.first[_idx].parent;
+    uint32_t sibling = NO_NODE;
+    if constexpr (Config::SIBLINGS) {
+      sibling = nodes.first[_idx].sibling;
+      if (sibling != NO_NODE) {
+        sibling += idx_shift;
+      }
+      // 祖先节点的下一个兄弟节点都在子树之后
+      for (auto i = parent; i != NO_NODE; i = nodes.first[i].parent) {
+        if (nodes.first[i].sibling != NO_NODE) {
+          nodes.first[i].sibling += idx_shift;
+        }
+      }
+      // 删除了最后一个子节点，上一个兄弟节点成为最后一个
+      if (_count == 0 && sibling == NO_NODE) {
+        for (auto i = _idx - 1; i != parent; i--) {
+          if (nodes.first[i].depth == base) {
+            nodes.first[i].sibling = NO_NODE;
+            break;
+          }
+        }
+      }
+    }
+    // 子树中的 phandle 不变时，指向子树之外的中断父节点只需要调整下标
+    bool phandles_changed = ph_end - ph_begin != _phandles_count;
+    uint32_t old_phandles[MAX_UPDATE_PHANDLES];
+    for (size_t i = ph_begin; !phandles_changed && i < ph_end; i++) {
+      old_phandles[i - ph_begin] = phandle_maps.first[i].phandle;
+    }
+
+    // 子树之前的节点只有数据区整体移动
+    for (size_t i = 0; _data_shift != 0 && i < _idx; i++) {
+      shift_node(nodes.first[i], _data_shift);
+    }
+    // 移动子树之后的节点，目标与来源重叠，按移动方向选择顺序
+    auto move = [&](size_t _from) {
+      size_t to = _from - (_next - _idx) + _count;
+      node_t& node = nodes.first[to];
+      node = nodes.first[_from];
+      shift_node(node, _data_shift + _shift);
+      if (node.parent >= _next) {
+        node.parent += idx_shift;
+      }
+      if constexpr (Config::SIBLINGS) {
+        if (node.sibling != NO_NODE) {
+          node.sibling += idx_shift;
+        }
+      }
+      if constexpr (Config::INVERTED_INDEXES) {
+        set_bit(memory_nodes, to, get_bit(memory_nodes, _from));
+        set_bit(okay_nodes, to, get_bit(okay_nodes, _from));
+      }
+    };
+    if (total > old_total) {
+      for (size_t i = old_total; i-- > _next;) {
+        move(i);
+      }
+    } else if (total < old_total || _data_shift + _shift != 0) {
+      for (size_t i = _next; i < old_total; i++) {
+        move(i);
+      }
+      if constexpr (Config::INVERTED_INDEXES) {
+        for (size_t i = total; i < old_total; i++) {
+          set_bit(memory_nodes, i, false);
+          set_bit(okay_nodes, i, false);
+        }
+      }
+    }
+    nodes.second = total;
+    // 移动子树之后的 phandle，新子树的 phandle 由 init_prop_info() 写入
+    if constexpr (Config::PHANDLES) {
+      auto move_phandle = [&](size_t _from) {
+        auto& map = phandle_maps.first[_from - ph_end + ph_begin +
+                                       _phandles_count];
+        map = phandle_maps.first[_from];
+        map.node += idx_shift;
+      };
+      if (ph_begin + _phandles_count > ph_end) {
+        for (size_t i = phandle_maps.second; i-- > ph_end;) {
+          move_phandle(i);
+        }
+      } else if (ph_begin + _phandles_count < ph_end || idx_shift != 0) {
+        for (size_t i = ph_end; i < phandle_maps.second; i++) {
+          move_phandle(i);
+        }
+      }
+      phandle_maps.second = ph_begin;
+    }
+
+    // 重新解析子树
+    auto strings = (const char*)(dtb_info.base + dtb_info.str);
+    size_t cur = _idx;
+    size_t end = _idx;
+    // 上一棵新子树的根节点
+    uint32_t prev = NO_NODE;
+    size_t depth = base - 1;
+    while (end < _idx + _count || depth >= base) {
+      auto words = (const uint32_t*)(dtb_info.base + off);
+      switch (fdt_parser_be32toh(words[0])) {
+        case FDT_BEGIN_NODE: {
+          depth++;
+          cur = end++;
+          if (depth == base) {
+            // 父节点不变，新子树之间依次链接
+            init_node_info(nodes, cur, off, depth);
+            nodes.first[cur].parent = parent;
+            if constexpr (Config::SIBLINGS) {
+              if (prev != NO_NODE) {
+                nodes.first[prev].sibling = cur;
+              }
+            }
+            prev = cur;
+          } else {
+            init_node(nodes, cur, off, depth);
+          }
+          off += 4 + align_up_power_of_two(
+                         fdt_strlen((const char*)(words + 1)) + 1, 4);
+          break;
+        }
+        case FDT_END_NODE: {
+          depth--;
+          off += 4;
+          break;
+        }
+        case FDT_PROP: {
+          auto len = fdt_parser_be32toh(words[1]);
+          auto nameoff = fdt_parser_be32toh(words[2]);
+          init_prop_info(nodes, phandle_maps, cur, strings + nameoff,
+                         words + 3);
+          add_prop(nodes, cur, nameoff, off + 12, len);
+          off += 12 + align_up_power_of_two(len, 4);
+          break;
+        }
+        default: {
+          // FDT_NOP
+          off += 4;
+          break;
+        }
+      }
+    }
+    // 最后一棵新子树的兄弟节点是原子树的兄弟节点
+    if constexpr (Config::SIBLINGS) {
+      if (prev != NO_NODE) {
+        nodes.first[prev].sibling = sibling;
+      }
+    }
+    if constexpr (Config::PHANDLES) {
+      for (size_t i = ph_begin; !phandles_changed && i < ph_end; i++) {
+        phandles_changed = phandle_maps.first[i].phandle !=
+                           old_phandles[i - ph_begin];
+      }
+      phandle_maps.second = ph_total;
+    }
+
+    // 中断父节点，phandle 改变后全部重新查找，否则只查找指向原子树的
+    if constexpr (Config::INTERRUPT_PARENTS) {
+      for (size_t i = 0; i < total; i++) {
+        auto& interrupt_parent = nodes.first[i].interrupt_parent;
+        if (phandles_changed || (i >= _idx && i < end)) {
+          update_interrupt_parent(i);
+        } else if (interrupt_parent == NO_NODE) {
+          continue;
+        } else if (interrupt_parent >= _idx && interrupt_parent < _next) {
+          update_interrupt_parent(i);
+        } else if (interrupt_parent >= _next) {
+          interrupt_parent += idx_shift;
+        }
+      }
+    }
+    if constexpr (Config::INVERTED_INDEXES) {
+      for (size_t i = _idx; i < end; i++) {
+        set_bit(memory_nodes, i, false);
+        set_bit(okay_nodes, i, false);
+        inverted_node(i);
+      }
+    }
+    // 子树与所有祖先节点的哈希
+    if constexpr (Config::HASHES) {
+      if (init_flags & DT_INIT_HASH) {
+        if (end != _idx) {
+          hash_subtree(_idx, end);
+        }
+        for (auto i = parent; i != NO_NODE; i = nodes.first[i].parent) {
+          hash_node(i);
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief 第一个不在 _idx 之前的节点的 phandle
+   * @param  _idx            节点下标
+   * @return size_t          在 phandle 数组中的下标
+   */
+  size_t phandle_lower_bound(uint32_t _idx) const {
+    size_t lo = 0;
+    size_t hi = phandle_maps.second;
+    while (lo < hi) {
+      auto mid = (lo + hi) / 2;
+      if (phandle_maps.first[mid].node < _idx) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  /**
+   * @brief 根据 interrupt-parent 属性重新设置中断父节点
+   * @param  _idx            节点下标
+   */
+  void update_interrupt_parent(size_t _idx) {
+    const node_t& node = nodes.first[_idx];
+    nodes.first[_idx].interrupt_parent = NO_NODE;
+    for (size_t j = 0; j < node.prop_count; j++) {
+      if (fdt_strcmp(prop_name(node.props[j]), "interrupt-parent") == 0) {
+        init_interrupt_parent(
+            nodes, phandle_maps, _idx,
+            fdt_parser_be32toh(*(const uint32_t*)prop_addr(node.props[j])));
+      }
+    }
+    return;
+  }
+
+  /**
+   * @brief 由子节点的哈希重新计算节点的哈希
+   * @param  _idx            节点下标
+   */
+  void hash_node(uint32_t _idx) {
+    auto acc = hash_node_head(nodes.first[_idx]);
+    if constexpr (Config::SIBLINGS) {
+      for (auto i = first_child(_idx); i != NO_NODE;
+           i = nodes.first[i].sibling) {
+        acc = hash_fold_child(acc, nodes.first[i].hash);
+      }
+    } else {
+      for (auto i = _idx + 1; i < subtree_end(_idx); i++) {
+        if (nodes.first[i].depth == nodes.first[_idx].depth + 1) {
+          acc = hash_fold_child(acc, nodes.first[i].hash);
+        }
+      }
+    }
+    nodes.first[_idx].hash = hash_mix(acc);
+    return;
+  }
+
+  /**
+   * @brief 读取位集合中的一位
+   * @param  _set            位集合
+   * @param  _idx            位下标
+   * @return true            已设置
+   * @return false           未设置
+   */
+  static bool get_bit(const uint64_t* _set, size_t _idx) {
+    return (_set[_idx / 64] >> (_idx % 64)) & 1;
+  }
+
+  /**
+   * @brief 设置位集合中的一位
+   * @param  _set            位集合
+   * @param  _idx            位下标
+   * @param  _value          值
+   */
+  static void set_bit(uint64_t* _set, size_t _idx, bool _value) {
+    if (_value) {
+      _set[_idx / 64] |= 1ULL << (_idx % 64);
+    } else {
+      _set[_idx / 64] &= ~(1ULL << (_idx % 64));
+    }
+    return;
+  }
+
+  /**
+   * @brief 填充 resource_t
+   * @param  _resource       被填充的
+   * @param  _node           源节点
+   * @param  _prop           填充的数据
+   * @param  _type           _prop 对应的资源类型
+   */
+  void fill_resource(resource_t& _resource, const node_t& _node,
+                     const prop_t& _prop, uint8_t _type) const {
+    // 如果 _resource 名称为空则使用 compatible，如果没有找到则使用 _node 路径
+    if (_resource.name == nullptr) {
+      for (size_t i = 0; i < _node.prop_count; i++) {
+        if (fdt_strcmp(prop_name(_node.props[i]), "compatible") == 0) {
+          _resource.name = (char*)prop_addr(_node.props[i]);
+        }
+        if (_resource.name == nullptr) {
+          _resource.name = (char*)node_name(_node);
+        }
+      }
+    }
+    auto data = (uint32_t*)prop_addr(_prop);
+    // 根节点使用自身的 cells 信息
+    const node_t& parent =
+        (_node.parent == NO_NODE) ? _node : nodes.first[_node.parent];
+    // 内存类型
+    if ((_type & resource_t::MEM) && (_resource.mem.len == 0)) {
+      // 根据 address_cells 与 size_cells 填充
+      // resource 一般来说两者是相等的
+      if (parent.address_cells == 1) {
+        fdt_parser_assert(parent.size_cells == 1);
+        _resource.mem.addr = fdt_parser_be32toh(data[0]);
+        _resource.mem.len = fdt_parser_be32toh(data[1]);
+      } else if (parent.address_cells == 2) {
+        fdt_parser_assert(parent.size_cells == 2);
+        _resource.mem.addr =
+            fdt_parser_be32toh(data[0]) + fdt_parser_be32toh(data[1]);
+        _resource.mem.len =
+            fdt_parser_be32toh(data[2]) + fdt_parser_be32toh(data[3]);
+      } else {
+        fdt_parser_assert(0);
+      }
+    } else if (_type & resource_t::INTR_NO) {
+      // 中断类型
+      _resource.intr_no = fdt_parser_be32toh(data[0]);
+    } else if (_type & resource_t::FREQUENCY) {
+      // cpu 速度类型
+      _resource.frequency = fdt_parser_be32toh(data[0]);
+    }
+    return;
+  }
+
+  /**
+   * @brief 判断节点的完整路径是否为 _path
+   * @param  _idx            节点下标
+   * @param  _path           路径，以 '/' 开始，省略 @ 及之后的部分时匹配单元地址
+   * @return true            相同
+   * @return false           不同
+   */
+  bool path_equal(uint32_t _idx, const char* _path) const {
+    // 路径必须以 ‘/’ 开始
+    if (_path[0] != '/') {
+      return false;
+    }
+    // 从节点向上收集祖先，不包括根节点
+    uint32_t chain[MAX_DEPTH];
+    size_t len = 0;
+    for (auto i = _idx; nodes.first[i].parent != NO_NODE;
+         i = nodes.first[i].parent) {
+      chain[len++] = i;
+    }
+    // 从根节点向下逐级比较
+    const char* p = _path;
+    while (len > 0) {
+      len--;
+      if (*p != '/') {
+        return false;
+      }
+      p++;
+      const char* name = node_name(nodes.first[chain[len]]);
+      size_t n = 0;
+      while (p[n] != '\0' && p[n] != '/') {
+        n++;
+      }
+      if (fdt_strncmp(name, p, n) != 0 ||
+          (name[n] != '\0' && name[n] != '@')) {
+        return false;
+      }
+      p += n;
+    }
+    // 允许以 '/' 结尾
+    return (p[0] == '\0') || (p[0] == '/' && p[1] == '\0');
+  }
+
+  /**
+   * @brief 判断名称是否匹配 glob
+   * @param  _pattern        glob，'*' 匹配任意个字符，'?' 匹配一个字符
+   * @param  _pattern_len    glob 长度
+   * @param  _name           名称
+   * @param  _name_len       名称长度
+   * @return true            匹配
+   * @return false           不匹配
+   */
+  static bool glob_match(const char* _pattern, size_t _pattern_len,
+                         const char* _name, size_t _name_len) {
+    size_t p = 0;
+    size_t n = 0;
+    // 上一个 '*' 的位置与它开始匹配的名称位置，不匹配时从这里回溯
+    size_t star = NO_STR;
+    size_t mark = 0;
+    while (n < _name_len) {
+      if (p < _pattern_len &&
+          (_pattern[p] == '?' ||
+           (_pattern[p] != '*' && _pattern[p] == _name[n]))) {
+        p++;
+        n++;
+      } else if (p < _pattern_len && _pattern[p] == '*') {
+        star = p++;
+        mark = n;
+      } else if (star != NO_STR) {
+        p = star + 1;
+        n = ++mark;
+      } else {
+        return false;
+      }
+    }
+    while (p < _pattern_len && _pattern[p] == '*') {
+      p++;
+    }
+    return p == _pattern_len;
+  }
+
+  /**
+   * @brief 判断节点的完整路径是否匹配 _glob
+   * @param  _idx            节点下标
+   * @param  _glob           路径，每一级名称可以使用 glob_match() 的通配符
+   * @return true            匹配
+   * @return false           不匹配
+   * @note 与 path_equal() 相同，某一级省略 @ 及之后的部分时匹配单元地址
+   */
+  bool path_glob(uint32_t _idx, const char* _glob) const {
+    if (_glob[0] != '/') {
+      return false;
+    }
+    // 各级名称在 _glob 中的起始位置与长度
+    size_t begins[MAX_DEPTH];
+    size_t lens[MAX_DEPTH];
+    size_t depth = 0;
+    for (size_t k = 0; _glob[k] != '\0';) {
+      if (_glob[k] == '/') {
+        k++;
+        continue;
+      }
+      if (depth == MAX_DEPTH) {
+        return false;
+      }
+      begins[depth] = k;
+      while (_glob[k] != '\0' && _glob[k] != '/') {
+        k++;
+      }
+      lens[depth] = k - begins[depth];
+      depth++;
+    }
+    // 从节点向上逐级比较，不匹配的节点大多在最后一级就可以排除
+    auto i = _idx;
+    for (; depth > 0 && nodes.first[i].parent != NO_NODE;
+         i = nodes.first[i].parent) {
+      depth--;
+      auto seg = _glob + begins[depth];
+      auto n = lens[depth];
+      bool wildcard = false;
+      bool has_at = false;
+      for (size_t k = 0; k < n; k++) {
+        wildcard |= seg[k] == '*' || seg[k] == '?';
+        has_at |= seg[k] == '@';
+      }
+      const char* name = node_name(nodes.first[i]);
+      if (!wildcard) {
+        // 没有通配符时与 path_equal() 相同
+        if (fdt_strncmp(name, seg, n) != 0 ||
+            (name[n] != '\0' && name[n] != '@')) {
+          return false;
+        }
+        continue;
+      }
+      size_t name_len = 0;
+      size_t base_len = NO_STR;
+      for (; name[name_len] != '\0'; name_len++) {
+        if (name[name_len] == '@' && base_len == NO_STR) {
+          base_len = name_len;
+        }
+      }
+      if (!glob_match(seg, n, name, name_len) &&
+          (has_at || base_len == NO_STR ||
+           !glob_match(seg, n, name, base_len))) {
+        return false;
+      }
+    }
+    // 层数相同时同时到达根节点
+    return depth == 0 && nodes.first[i].parent == NO_NODE;
+  }
+
+  /**
+   * @brief 判断属性是否满足属性条件
+   * @param  _prop           与条件同名的属性
+   * @param  _predicate      HAS_PROP、STRING 或 CELL 条件
+   * @return true            满足
+   * @return false           不满足
+   */
+  bool prop_match(const prop_t& _prop,
+                  const predicate_t& _predicate) const {
+    switch (_predicate.type) {
+      case predicate_t::STRING: {
+        return prop_has_string(_prop, _predicate.str);
+      }
+      case predicate_t::CELL: {
+        if (_prop.len / 4 <= _predicate.cell) {
+          return false;
+        }
+        auto cells = (const uint32_t*)prop_addr(_prop);
+        return fdt_parser_be32toh(cells[_predicate.cell]) == _predicate.value;
+      }
+      default: {
+        return true;
+      }
+    }
+  }
+
+  /**
+   * @brief 判断节点是否满足 plan 中尚未由倒排索引满足的条件
+   * @param  _plan           compile() 的结果
+   * @param  _idx            节点下标
+   * @return true            满足
+   * @return false           不满足
+   * @note PATH 条件先比较深度，属性条件在一次属性遍历中同时判断，
+   * 节点中属性名唯一，同名属性不满足时立即返回
+   */
+  bool plan_match(const plan_t& _plan, uint32_t _idx) const {
+    const node_t& node = nodes.first[_idx];
+    for (size_t s = 0; s < _plan.props_begin; s++) {
+      // 根节点深度为 1
+      if (node.depth != _plan.depths[s] + 1 ||
+          !path_glob(_idx, _plan.steps[s].key)) {
+        return false;
+      }
+    }
+    // 尚未满足的属性条件
+    uint32_t pending = ((1U << _plan.count) - 1) &
+                       ~((1U << _plan.props_begin) - 1);
+    for (size_t i = 0; i < node.prop_count && pending != 0; i++) {
+      auto name = prop_name(node.props[i]);
+      for (size_t s = _plan.props_begin; s < _plan.count; s++) {
+        auto key = _plan.steps[s].key;
+        if ((pending & (1U << s)) == 0 || name[0] != key[0] ||
+            fdt_strcmp(name, key) != 0) {
+          continue;
+        }
+        if (!prop_match(node.props[i], _plan.steps[s])) {
+          return false;
+        }
+        pending &= ~(1U << s);
+      }
+    }
+    return pending == 0;
+  }
+
+  /**
+   * @brief 获取一组 64 个节点中满足倒排索引条件的节点
+   * @param  _plan           compile() 的结果
+   * @param  _word           第几组
+   * @return uint64_t        节点位图，不包括超出节点数的部分
+   */
+  uint64_t plan_candidates(const plan_t& _plan, size_t _word) const {
+    uint64_t res = ~0ULL;
+    if (nodes.second - _word * 64 < 64) {
+      res = (1ULL << (nodes.second - _word * 64)) - 1;
+    }
+    if constexpr (Config::INVERTED_INDEXES) {
+      if (_plan.indexes & plan_t::INDEX_MEMORY) {
+        res &= memory_nodes[_word];
+      }
+      if (_plan.indexes & plan_t::INDEX_OKAY) {
+        res &= okay_nodes[_word];
+      }
+    }
+    return res;
+  }
+
+  /**
+   * @brief 对满足 plan 的每个节点调用 _fn，节点按在 dtb 中的顺序
+   * @param  _plan           compile() 的结果
+   * @param  _fn             以节点下标为参数
+   * @return size_t          匹配的节点数
+   */
+  template <class F>
+  size_t plan_each(const plan_t& _plan, F _fn) const {
+    size_t res = 0;
+    for (size_t w = 0; w * 64 < nodes.second; w++) {
+      // 跳过没有候选节点的整组
+      auto candidates = plan_candidates(_plan, w);
+      for (uint32_t i = w * 64; candidates != 0; candidates >>= 1, i++) {
+        if ((candidates & 1) && plan_match(_plan, i)) {
+          _fn(i, res);
+          res++;
+        }
+      }
+    }
+    return res;
+  }
+
+  /**
+   * @brief 通过路径寻找节点
+   * @param  _path            路径
+   * @return const node_t*    找到的节点
+   */
+  const node_t* find_node_via_path(const char* _path) const {
+    const node_t* res = nullptr;
+    // 遍历 nodes
+    for (size_t i = 0; i < nodes.second; i++) {
+      // 如果 nodes[i] 的路径符合要求
+      if (path_equal(i, _path)) {
+        // 设置返回值
+        res = &nodes.first[i];
+      }
+    }
+    return res;
+  }
+
+  /**
+   * @brief 在节点中查找属性
+   * @param  _node           要查找的节点
+   * @param  _prop_name      属性名
+   * @return const prop_t*   找到的属性，未找到时为 nullptr
+   */
+  const prop_t* get_prop(const node_t& _node, const char* _prop_name) const {
+    for (size_t i = 0; i < _node.prop_count; i++) {
+      if (fdt_strcmp(prop_name(_node.props[i]), _prop_name) == 0) {
+        return &_node.props[i];
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * @brief 读取 u32 类型的属性
+   * @param  _prop           属性，可以为 nullptr
+   * @param  _default        属性不存在时的默认值
+   * @return uint32_t        属性值
+   */
+  uint32_t get_prop_u32(const prop_t* _prop, uint32_t _default) const {
+    if (_prop == nullptr || _prop->len < 4) {
+      return _default;
+    }
+    return fdt_parser_be32toh(((uint32_t*)prop_addr(*_prop))[0]);
+  }
+
+  /**
+   * @brief 判断字符串列表类型的属性是否包含 _str
+   * @param  _prop           属性，如 compatible
+   * @param  _str            要查找的字符串
+   * @return true            包含
+   * @return false           不包含
+   */
+  bool prop_has_string(const prop_t& _prop, const char* _str) const {
+    auto str = (const char*)prop_addr(_prop);
+    for (size_t i = 0; i < _prop.len;) {
+      // 不是以 '\0' 结尾的字符串时停止，不读取属性之外的数据
+      auto len = str_len(str + i, _prop.len - i);
+      if (len == NO_STR) {
+        break;
+      }
+      if (fdt_strcmp(str + i, _str) == 0) {
+        return true;
+      }
+      i += len + 1;
+    }
+    return false;
+  }
+
+  /**
+   * @brief 使用节点的 reg/interrupts/timebase-frequency 填充 resource_t
+   * @param  _resource       被填充的
+   * @param  _node           源节点
+   * @param  _types          要填充的 resource_t 类型
+   * @note 只填充 Config::RESOURCES 中的类型，其余类型的比较在编译期去掉
+   */
+  void fill_node_resource(resource_t& _resource, const node_t& _node,
+                          uint8_t _types = resource_t::MEM |
+                                           resource_t::INTR_NO |
+                                           resource_t::FREQUENCY) const {
+    _types &= Config::RESOURCES;
+    for (size_t i = 0; i < _node.prop_count; i++) {
+      const char* name = prop_name(_node.props[i]);
+      if ((_types & resource_t::MEM) && fdt_strcmp(name, "reg") == 0) {
+        _resource.type |= resource_t::MEM;
+        // 填充数据
+        fill_resource(_resource, _node, _node.props[i], resource_t::MEM);
+      } else if ((_types & resource_t::INTR_NO) &&
+                 fdt_strcmp(name, "interrupts") == 0) {
+        _resource.type |= resource_t::INTR_NO;
+        // 填充数据
+        fill_resource(_resource, _node, _node.props[i], resource_t::INTR_NO);
+      } else if ((_types & resource_t::FREQUENCY) &&
+                 fdt_strcmp(name, "timebase-frequency") == 0) {
+        _resource.type |= resource_t::FREQUENCY;
+        // 填充数据
+        fill_resource(_resource, _node, _node.props[i],
+                      resource_t::FREQUENCY);
+      }
+    }
+    return;
+  }
+
+  /**
+   * @brief 解析形如 cluster0 的节点名中的编号
+   * @param  _name           节点名
+   * @param  _prefix         编号前的名称
+   * @param  _idx            解析出的编号
+   * @return true            _name 以 _prefix 开始且后面为数字
+   * @return false           格式不匹配
+   */
+  static bool parse_name_index(const char* _name, const char* _prefix,
+                               uint16_t& _idx) {
+    size_t len = fdt_strlen(_prefix);
+    if (fdt_strncmp(_name, _prefix, len) != 0 || _name[len] == '\0') {
+      return false;
+    }
+    uint16_t idx = 0;
+    for (const char* c = _name + len; *c != '\0'; c++) {
+      if (*c < '0' || *c > '9') {
+        return false;
+      }
+      idx = idx * 10 + (*c - '0');
+    }
+    _idx = idx;
+    return true;
+  }
+
+  /**
+   * @brief 判断节点是否为 /cpus 下的 cpu 节点
+   * @param  _node           要判断的节点
+   * @return true            是
+   * @return false           否
+   */
+  bool is_cpu_node(const node_t& _node) const {
+    if (_node.parent == NO_NODE || nodes.first[_node.parent].depth != 2 ||
+        fdt_strcmp(node_name(nodes.first[_node.parent]), "cpus") != 0) {
+      return false;
+    }
+    if (get_prop(_node, "device_type") != nullptr) {
+      return node_find(_node, "device_type", "cpu");
+    }
+    return fdt_strncmp(node_name(_node), "cpu@", 4) == 0;
+  }
+
+  /**
+   * @brief 填充单个 cpu 的信息
+   * @param  _cpu            被填充的
+   * @param  _node           cpu 节点
+   * @return true            成功
+   * @return false           /cpus 的 #address-cells 大于 2，hart id 超过 64 位
+   */
+  bool fill_cpu(cpu_topology_t::cpu_t& _cpu, const node_t& _node) const {
+    // reg 的长度由 /cpus 的 #address-cells 决定，只保留低位会使 hart id 重复
+    if (nodes.first[_node.parent].address_cells > 2) {
+      return false;
+    }
+    auto reg = get_prop(_node, "reg");
+    _cpu.hartid = 0;
+    if (reg != nullptr) {
+      auto cells = (uint32_t*)prop_addr(*reg);
+      for (size_t i = 0;
+           i < nodes.first[_node.parent].address_cells && i < reg->len / 4;
+           i++) {
+        _cpu.hartid = (_cpu.hartid << 32) | fdt_parser_be32toh(cells[i]);
+      }
+    }
+    // 没有 status 或 status 为 okay 时可用
+    auto status = get_prop(_node, "status");
+    _cpu.enabled = (status == nullptr) || prop_has_string(*status, "okay") ||
+                   prop_has_string(*status, "ok");
+    // 解析 riscv,isa 中的单字母扩展，如 rv64imafdcsu
+    auto isa = get_prop(_node, "riscv,isa");
+    _cpu.isa = nullptr;
+    _cpu.isa_ext = 0;
+    if (isa != nullptr) {
+      _cpu.isa = (char*)prop_addr(*isa);
+      const char* c = _cpu.isa;
+      // 跳过 rv32/rv64/rv128
+      if (fdt_strncmp(c, "rv", 2) == 0) {
+        c += 2;
+        while (*c >= '0' && *c <= '9') {
+          c++;
+        }
+      }
+      for (; *c >= 'a' && *c <= 'z'; c++) {
+        _cpu.isa_ext |= 1U << (*c - 'a');
+        // g 为 imafd 的简写
+        if (*c == 'g') {
+          _cpu.isa_ext |= (1U << ('i' - 'a')) | (1U << ('m' - 'a')) |
+                          (1U << ('a' - 'a')) | (1U << ('f' - 'a')) |
+                          (1U << ('d' - 'a'));
+        }
+      }
+    }
+    _cpu.phandle = _node.phandle;
+    _cpu.numa_node = get_prop_u32(get_prop(_node, "numa-node-id"), 0);
+    _cpu.i_cache_size = get_prop_u32(get_prop(_node, "i-cache-size"), 0);
+    _cpu.i_cache_sets = get_prop_u32(get_prop(_node, "i-cache-sets"), 0);
+    _cpu.i_cache_block_size =
+        get_prop_u32(get_prop(_node, "i-cache-block-size"), 0);
+    _cpu.d_cache_size = get_prop_u32(get_prop(_node, "d-cache-size"), 0);
+    _cpu.d_cache_sets = get_prop_u32(get_prop(_node, "d-cache-sets"), 0);
+    _cpu.d_cache_block_size =
+        get_prop_u32(get_prop(_node, "d-cache-block-size"), 0);
+    _cpu.next_level_cache =
+        get_prop_u32(get_prop(_node, "next-level-cache"), 0);
+    return true;
+  }
+
+  /**
+   * @brief 根据 cpu-map 中的叶子节点设置 cpu 位置
+   * @param  _topology       拓扑信息
+   * @param  _idx            cpu-map 下含有 cpu 属性的节点下标
+   */
+  void fill_cpu_map(cpu_topology_t& _topology, uint32_t _idx) const {
+    auto phandle = get_prop_u32(get_prop(nodes.first[_idx], "cpu"), 0);
+    cpu_topology_t::cpu_t* cpu = nullptr;
+    for (size_t i = 0; i < _topology.cpu_count; i++) {
+      if (_topology.cpus[i].phandle == phandle) {
+        cpu = &_topology.cpus[i];
+      }
+    }
+    if (phandle == 0 || cpu == nullptr) {
+      return;
+    }
+    // 从叶子向上直到 cpu-map，嵌套 cluster 时使用最内层的编号
+    bool has_cluster = false;
+    cpu->socket = 0;
+    cpu->cluster = 0;
+    cpu->thread = 0;
+    for (auto i = _idx; i != NO_NODE; i = nodes.first[i].parent) {
+      const char* name = node_name(nodes.first[i]);
+      if (fdt_strcmp(name, "cpu-map") == 0) {
+        break;
+      }
+      uint16_t idx = 0;
+      if (parse_name_index(name, "socket", idx)) {
+        cpu->socket = idx;
+      } else if (parse_name_index(name, "cluster", idx) && !has_cluster) {
+        cpu->cluster = idx;
+        has_cluster = true;
+      } else if (parse_name_index(name, "core", idx)) {
+        cpu->core = idx;
+      } else if (parse_name_index(name, "thread", idx)) {
+        cpu->thread = idx;
+      }
+    }
+    return;
+  }
+
+ public:
+  // 用于控制处理哪些属性
+  /// 处理节点开始
+  static constexpr const uint8_t DT_ITER_BEGIN_NODE = 0x01;
+  /// 处理节点结束
+  static constexpr const uint8_t DT_ITER_END_NODE = 0x02;
+  /// 处理节点属性
+  static constexpr const uint8_t DT_ITER_PROP = 0x04;
+
+  // 用于控制 dtb_init 构建哪些可选信息
+  /// 计算子树哈希
+  static constexpr const uint8_t DT_INIT_HASH = 0x01;
+
+  /**
+   * @brief 检查 fdt 头
+   * @param  _header         fdt 头
+   * @param  _size           dtb 所在缓冲区的长度
+   * @return true            魔数与版本正确，各区域都在 totalsize 内并且对齐
+   * @return false           否
+   */
+  static bool header_ok(const fdt_header_t* _header, size_t _size) {
+    auto total = fdt_parser_be32toh(_header->totalsize);
+    auto reserved = fdt_parser_be32toh(_header->off_mem_rsvmap);
+    auto data = fdt_parser_be32toh(_header->off_dt_struct);
+    auto data_size = fdt_parser_be32toh(_header->size_dt_struct);
+    auto str = fdt_parser_be32toh(_header->off_dt_strings);
+    auto str_size = fdt_parser_be32toh(_header->size_dt_strings);
+    return fdt_parser_be32toh(_header->magic) == FDT_MAGIC &&
+           fdt_parser_be32toh(_header->version) >= FDT_VERSION &&
+           fdt_parser_be32toh(_header->last_comp_version) <= FDT_VERSION &&
+           total >= sizeof(fdt_header_t) && total <= _size &&
+           in_blob(data, data_size, total) && in_blob(str, str_size, total) &&
+           reserved % 8 == 0 && data % 4 == 0 && data_size % 4 == 0;
+  }
+
+  /**
+   * @brief 检查保留区以全 0 的项结束
+   * @param  _dtb_addr       dtb 地址
+   * @return true            是
+   * @return false           结束项不在 totalsize 内
+   * @note 需要先通过 header_ok()
+   */
+  static bool reserved_ok(uintptr_t _dtb_addr) {
+    auto header = (const fdt_header_t*)_dtb_addr;
+    auto total = fdt_parser_be32toh(header->totalsize);
+    for (auto off = fdt_parser_be32toh(header->off_mem_rsvmap);;
+         off += sizeof(fdt_reserve_entry_t)) {
+      if (!in_blob(off, sizeof(fdt_reserve_entry_t), total)) {
+        return false;
+      }
+      auto entry = (const fdt_reserve_entry_t*)(_dtb_addr + off);
+      if (!(entry->addr_be || entry->addr_le || entry->size_be ||
+            entry->size_le)) {
+        return true;
+      }
+    }
+  }
+
+  /**
+   * @brief 检查 dtb 的结构
+   * @param  _dtb_addr       dtb 二进制信息地址
+   * @param  _size           _dtb_addr 处可以读取的长度
+   * @param  _validated      通过时保存检查结果
+   * @return true            通过
+   * @return false           dtb 不完整或格式错误
+   * @note 只遍历一次数据区，检查头信息中的偏移与长度、token 的对齐与嵌套、
+   * 节点名与属性名是否以 '\0' 结尾，以及属性是否在子节点之前
+   * @note 超出索引容量的 dtb 仍然可以通过检查，见 fdt_validated_t::fits()
+   */
+  static bool validate(uintptr_t _dtb_addr, size_t _size,
+                       fdt_validated_t& _validated) {
+    if (_size < sizeof(fdt_header_t)) {
+      return false;
+    }
+    auto header = (const fdt_header_t*)_dtb_addr;
+    if (!header_ok(header, _size) || !reserved_ok(_dtb_addr)) {
+      return false;
+    }
+    auto total = fdt_parser_be32toh(header->totalsize);
+    auto data = fdt_parser_be32toh(header->off_dt_struct);
+    auto data_size = fdt_parser_be32toh(header->size_dt_struct);
+    auto str = fdt_parser_be32toh(header->off_dt_strings);
+    auto str_size = fdt_parser_be32toh(header->size_dt_strings);
+
+    auto words = (const uint32_t*)(_dtb_addr + data);
+    auto strings = (const char*)(_dtb_addr + str);
+    size_t count = data_size / 4;
+    size_t pos = 0;
+    size_t depth = 0;
+    size_t nodes_count = 0;
+    size_t props_count = 0;
+    size_t phandles_count = 0;
+    // 索引需要的容量
+    size_t max_depth = 0;
+    size_t max_props = 0;
+    // 根节点已结束
+    bool root_done = false;
+    // 刚结束了一个子节点，此时不能再出现父节点的属性
+    bool after_child = false;
+    while (pos < count) {
+      switch (fdt_parser_be32toh(words[pos])) {
+        case FDT_NOP: {
+          pos++;
+          break;
+        }
+        case FDT_BEGIN_NODE: {
+          if (root_done) {
+            return false;
+          }
+          auto name = (const char*)(words + pos + 1);
+          auto name_len = str_len(name, (count - pos - 1) * 4);
+          if (name_len == NO_STR) {
+            return false;
+          }
+          pos += 1 + align_up_power_of_two(name_len + 1, 4) / 4;
+          depth++;
+          nodes_count++;
+          if (depth > max_depth) {
+            max_depth = depth;
+          }
+          props_count = 0;
+          after_child = false;
+          break;
+        }
+        case FDT_END_NODE: {
+          if (depth == 0) {
+            return false;
+          }
+          depth--;
+          root_done = depth == 0;
+          after_child = true;
+          pos++;
+          break;
+        }
+        case FDT_PROP: {
+          if (depth == 0 || after_child || count - pos < 3) {
+            return false;
+          }
+          size_t len = fdt_parser_be32toh(words[pos + 1]);
+          auto nameoff = fdt_parser_be32toh(words[pos + 2]);
+          if (len > (count - pos - 3) * 4 || nameoff >= str_size) {
+            return false;
+          }
+          auto name = strings + nameoff;
+          if (str_len(name, str_size - nameoff) == NO_STR) {
+            return false;
+          }
+          props_count++;
+          if (fdt_strcmp(name, "phandle") == 0) {
+            phandles_count++;
+          }
+          if (props_count > max_props) {
+            max_props = props_count;
+          }
+          pos += 3 + align_up_power_of_two(len, 4) / 4;
+          break;
+        }
+        case FDT_END: {
+          if (!root_done) {
+            return false;
+          }
+          _validated =
+              fdt_validated_t(_dtb_addr, total, max_depth, nodes_count,
+                              max_props, phandles_count);
+          return true;
+        }
+        default: {
+          return false;
+        }
+      }
+    }
+    // 没有 FDT_END
+    return false;
+  }
+
+  /**
+   * @brief 检查 dtb 的结构，以 totalsize 作为可以读取的长度
+   * @param  _dtb_addr       dtb 二进制信息地址
+   * @param  _validated      通过时保存检查结果
+   * @return true            通过
+   * @return false           dtb 格式错误
+   * @note 只能用于已知 totalsize 可信的 dtb，例如 bootloader 传入的
+   */
+  static bool validate(uintptr_t _dtb_addr, fdt_validated_t& _validated) {
+    auto header = (const fdt_header_t*)_dtb_addr;
+    if (fdt_parser_be32toh(header->magic) != FDT_MAGIC) {
+      return false;
+    }
+    return validate(_dtb_addr, fdt_parser_be32toh(header->totalsize),
+                    _validated);
+  }
+
+  /**
+   * @brief 不建立索引，直接计算已检查的 dtb 的根哈希
+   * @param  _validated      validate() 的结果
+   * @return uint64_t         与使用 DT_INIT_HASH 建立的索引的 root_hash()
+   * 相同，深度超出 MAX_DEPTH 时为 0
+   * @note 只需要 MAX_DEPTH 个累加器，可以在复用缓存的索引前识别相同的 dtb
+   */
+  static uint64_t blob_hash(const fdt_validated_t& _validated) {
+    static_assert(Config::HASHES, "hashes are disabled in Config");
+    if (_validated.depth > MAX_DEPTH) {
+      return 0;
+    }
+    auto header = (const fdt_header_t*)_validated.dtb_addr();
+    auto addr = (const uint32_t*)(_validated.dtb_addr() +
+                                  fdt_parser_be32toh(header->off_dt_struct));
+    auto str =
+        _validated.dtb_addr() + fdt_parser_be32toh(header->off_dt_strings);
+    // 每一级尚未结束的节点的哈希
+    uint64_t acc[MAX_DEPTH];
+    size_t depth = 0;
+    uint64_t res = 0;
+    while (1) {
+      switch (fdt_parser_be32toh(addr[0])) {
+        case FDT_BEGIN_NODE: {
+          auto name = (const char*)(addr + 1);
+          acc[depth++] = hash_node_name(name);
+          addr += 1 + align_up_power_of_two(fdt_strlen(name) + 1, 4) / 4;
+          break;
+        }
+        case FDT_END_NODE: {
+          depth--;
+          auto hash = hash_mix(acc[depth]);
+          if (depth > 0) {
+            acc[depth - 1] = hash_fold_child(acc[depth - 1], hash);
+          } else {
+            res = hash;
+          }
+          addr++;
+          break;
+        }
+        case FDT_PROP: {
+          auto len = fdt_parser_be32toh(addr[1]);
+          auto name = (const char*)(str + fdt_parser_be32toh(addr[2]));
+          acc[depth - 1] =
+              hash_fold(acc[depth - 1], hash_prop(name, addr + 3, len));
+          addr += 3 + align_up_power_of_two(len, 4) / 4;
+          break;
+        }
+        case FDT_END: {
+          return res;
+        }
+        default: {
+          // FDT_NOP
+          addr++;
+          break;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief 不建立索引，直接计算 dtb 的根哈希
+   * @param  _dtb_addr        dtb 二进制信息地址
+   * @return uint64_t         dtb 格式错误时为 0
+   */
+  static uint64_t blob_hash(uintptr_t _dtb_addr) {
+    fdt_validated_t validated;
+    if (!validate(_dtb_addr, validated)) {
+      return 0;
+    }
+    return blob_hash(validated);
+  }
+
+  /**
+   * @brief 根哈希，相同的 dtb 根哈希相同
+   * @return uint64_t         没有使用 DT_INIT_HASH 初始化时为 0
+   */
+  uint64_t root_hash(void) const {
+    static_assert(Config::HASHES, "hashes are disabled in Config");
+    if (!(init_flags & DT_INIT_HASH) || nodes.second == 0) {
+      return 0;
+    }
+    return nodes.first[0].hash;
+  }
+
+  /**
+   * @brief 比较两个索引，只进入子树哈希不同的节点
+   * @param  _other           新索引，本索引视为旧索引
+   * @param  _cb              每个差异调用一次，可以为 nullptr
+   * @param  _data            要传递给 _cb 的数据
+   * @return size_t           差异数
+   * @note 子节点与属性按名称匹配，新增或删除的子树只报告一次；
+   * 两个索引都使用 DT_INIT_HASH 初始化时才能跳过相同的子树
+   */
+  size_t diff(const basic_fdt_index& _other, diff_callback_t _cb,
+              void* _data) const {
+    static_assert(Config::SIBLINGS, "siblings are disabled in Config");
+    if (nodes.second == 0 || _other.nodes.second == 0) {
+      return 0;
+    }
+    return diff_node(_other, 0, 0, _cb, _data);
+  }
+
+  /**
+   * @brief 第一个子节点
+   * @param  _idx             节点下标
+   * @return uint32_t         子节点下标，没有时为 NO_NODE
+   * @note 其余子节点通过 node_t::sibling 访问
+   */
+  uint32_t first_child(uint32_t _idx) const {
+    static_assert(Config::SIBLINGS, "siblings are disabled in Config");
+    if (_idx + 1 < nodes.second &&
+        nodes.first[_idx + 1].depth == nodes.first[_idx].depth + 1) {
+      return _idx + 1;
+    }
+    return NO_NODE;
+  }
+
+  /**
+   * @brief 根据节点名查找子节点
+   * @param  _idx             父节点下标
+   * @param  _name            子节点名
+   * @return uint32_t         子节点下标，没有时为 NO_NODE
+   */
+  uint32_t find_child(uint32_t _idx, const char* _name) const {
+    static_assert(Config::SIBLINGS, "siblings are disabled in Config");
+    for (auto i = first_child(_idx); i != NO_NODE; i = nodes.first[i].sibling) {
+      if (fdt_strcmp(node_name(nodes.first[i]), _name) == 0) {
+        return i;
+      }
+    }
+    return NO_NODE;
+  }
+
+  /**
+   * @brief 有效节点数
+   * @return size_t           节点数
+   */
+  size_t node_count(void) const { return nodes.second; }
+
+  /**
+   * @brief 获取节点，节点按照在 dtb 中的先序排列，0 为根节点
+   * @param  _idx             节点下标
+   * @return const node_t&    节点
+   */
+  const node_t& node(size_t _idx) const { return nodes.first[_idx]; }
+
+  /**
+   * @brief 获取节点名
+   * @param  _node            节点
+   * @return const char*      节点名，根节点为 ""
+   */
+  const char* node_name(const node_t& _node) const {
+    return (const char*)(dtb_info.base + _node.off + 4);
+  }
+
+  /**
+   * @brief 获取属性名
+   * @param  _prop            属性
+   * @return const char*      属性名
+   */
+  const char* prop_name(const prop_t& _prop) const {
+    return (const char*)(dtb_info.base + dtb_info.str + _prop.nameoff);
+  }
+
+  /**
+   * @brief 获取属性数据地址
+   * @param  _prop            属性
+   * @return uintptr_t        属性数据地址，数据为大端序
+   */
+  uintptr_t prop_addr(const prop_t& _prop) const {
+    return dtb_info.base + _prop.off;
+  }
+
+  /**
+   * @brief 根据路径查找节点，返回使用的资源
+   * @param  _path            节点路径
+   * @param  _resource        资源
+   * @return true             成功
+   * @return false            失败
+   */
+  bool find_via_path(const char* _path, resource_t* _resource) const {
+    // 找到节点
+    auto node = find_node_via_path(_path);
+    if (node == nullptr) {
+      return false;
+    }
+    // 填充 reg/interrupts 等信息
+    fill_node_resource(_resource[0], *node);
+    return true;
+  }
+
+  /**
+   * @brief 根据节点名进行前缀查找
+   * @param  _prefix          要查找节点的前缀
+   * @param  _resource        结果数组
+   * @return size_t           _resource 长度
+   * @note 根据节点 @ 前的名称查找，可能返回多个 resource
+   */
+  size_t find_via_prefix(const char* _prefix, resource_t* _resource) const {
+    size_t res = 0;
+    // 遍历所有节点，查找
+    // 由于 @ 均为最底层节点，所以直接比较最后一级即可
+    for (size_t i = 0; i < nodes.second; i++) {
+      if (fdt_strncmp(node_name(nodes.first[i]), _prefix,
+                      fdt_strlen(_prefix)) == 0) {
+        fill_node_resource(_resource[res], nodes.first[i]);
+        res++;
+      }
+    }
+    return res;
+  }
+
+  /**
+   * @brief 根据 compatible 查找节点
+   * @param  _compatible      compatible 中的任意一项
+   * @param  _resource        结果数组
+   * @return size_t           _resource 长度
+   * @note 可能返回多个 resource，按节点在 dtb 中的顺序排列
+   */
+  size_t find_via_compatible(const char* _compatible,
+                             resource_t* _resource) const {
+    size_t res = 0;
+    for (size_t i = 0; i < nodes.second; i++) {
+      if (node_find(nodes.first[i], "compatible", _compatible)) {
+        fill_node_resource(_resource[res], nodes.first[i]);
+        res++;
+      }
+    }
+    return res;
+  }
+
+  /**
+   * @brief 批量查询，只遍历一次节点数组
+   * @param  _queries         查询数组，结果写入各查询的 resource 与 count
+   * @param  _count           查询数
+   * @return size_t           有匹配节点的查询数
+   * @note 每个节点只读取一次并依次与所有查询比较，节点的 compatible
+   * 只在有 COMPATIBLE 查询时查找一次，PATH 查询先比较深度
+   * @note PATH 查询省略 unit address 时可能匹配多个节点，与其它查询一样
+   * 按节点在 dtb 中的顺序返回
+   */
+  size_t find_batch(query_t* _queries, size_t _count) const {
+    bool has_compatible = false;
+    for (size_t q = 0; q < _count; q++) {
+      auto& query = _queries[q];
+      query.count = 0;
+      if (query.type == query_t::PATH) {
+        // 每个后面跟着名称的 '/' 是一层
+        query.key_len = 0;
+        query.key_tail = 0;
+        for (size_t k = 0; query.key[k] != '\0'; k++) {
+          if (query.key[k] == '/' && query.key[k + 1] != '\0' &&
+              query.key[k + 1] != '/') {
+            query.key_len++;
+            query.key_tail = k + 1;
+          }
+        }
+      } else {
+        query.key_len = fdt_strlen(query.key);
+        has_compatible |= query.type == query_t::COMPATIBLE;
+      }
+    }
+    // 节点 compatible 中的字符串，每个节点只查找一次
+    const char* strs[PROP_MAX_COUNT];
+    for (size_t i = 0; i < nodes.second; i++) {
+      const node_t& node = nodes.first[i];
+      auto name = node_name(node);
+      size_t strs_count = 0;
+      // 字符串过多时退回逐个比较
+      bool strs_full = false;
+      const prop_t* compatible = nullptr;
+      if (has_compatible) {
+        compatible = get_prop(node, "compatible");
+      }
+      if (compatible != nullptr) {
+        auto str = (const char*)prop_addr(*compatible);
+        for (size_t k = 0; k < compatible->len;) {
+          // 不是以 '\0' 结尾的字符串时停止，不读取属性之外的数据
+          auto len = str_len(str + k, compatible->len - k);
+          if (len == NO_STR) {
+            break;
+          }
+          if (strs_count == PROP_MAX_COUNT) {
+            strs_full = true;
+            break;
+          }
+          strs[strs_count++] = str + k;
+          k += len + 1;
+        }
+      }
+      for (size_t q = 0; q < _count; q++) {
+        auto& query = _queries[q];
+        bool match = false;
+        switch (query.type) {
+          case query_t::PREFIX: {
+            // 先比较第一个字符
+            match = query.key_len == 0 ||
+                    (name[0] == query.key[0] &&
+                     fdt_strncmp(name, query.key, query.key_len) == 0);
+            break;
+          }
+          case query_t::PATH: {
+            // 根节点深度为 1，先比较深度与最后一级名称
+            if (node.depth != query.key_len + 1) {
+              break;
+            }
+            auto tail = query.key + query.key_tail;
+            size_t n = 0;
+            while (tail[n] != '\0' && tail[n] != '/') {
+              n++;
+            }
+            match = fdt_strncmp(name, tail, n) == 0 &&
+                    (name[n] == '\0' || name[n] == '@') &&
+                    path_equal(i, query.key);
+            break;
+          }
+          case query_t::COMPATIBLE: {
+            if (strs_full) {
+              match = prop_has_string(*compatible, query.key);
+              break;
+            }
+            for (size_t k = 0; k < strs_count && !match; k++) {
+              match = strs[k][0] == query.key[0] &&
+                      fdt_strcmp(strs[k], query.key) == 0;
+            }
+            break;
+          }
+        }
+        if (match) {
+          if (query.count < query.capacity) {
+            fill_node_resource(query.resource[query.count], node,
+                               query.resource_types);
+          }
+          query.count++;
+        }
+      }
+    }
+    size_t res = 0;
+    for (size_t q = 0; q < _count; q++) {
+      if (_queries[q].count != 0) {
+        res++;
+      }
+    }
+    return res;
+  }
+
+  /**
+   * @brief 查找节点中的属性与值
+   * @param  _node            要查找的节点
+   * @param  _prop_name       属性名
+   * @param  _val             值，字符串列表中有一项相同即可，为 nullptr 时
+   * 只判断属性是否存在
+   * @return true             找到
+   * @return false            没有找到
+   */
+  bool node_find(const node_t& _node, const char* _prop_name,
+                 const char* _val) const {
+    auto prop = get_prop(_node, _prop_name);
+    if (prop == nullptr) {
+      return false;
+    }
+    return _val == nullptr || prop_has_string(*prop, _val);
+  }
+
+  /**
+   * @brief 将一组条件编译为 select() 使用的 plan
+   * @param  _predicates      条件数组，全部满足时节点匹配
+   * @param  _count           条件数，不超过 plan_t::MAX_STEPS
+   * @param  _plan            结果
+   * @return true             成功
+   * @return false            条件过多或格式错误
+   * @note 有倒排索引的 STRING 条件不再逐个节点检查，PATH 条件排在属性条件
+   * 之前，先比较深度，属性条件在一次属性遍历中同时判断
+   */
+  static bool compile(const predicate_t* _predicates, size_t _count,
+                      plan_t& _plan) {
+    _plan = plan_t();
+    if (_count > plan_t::MAX_STEPS) {
+      return false;
+    }
+    // 第一遍处理 PATH，第二遍处理属性条件
+    for (size_t pass = 0; pass < 2; pass++) {
+      for (size_t i = 0; i < _count; i++) {
+        auto& predicate = _predicates[i];
+        if ((predicate.type == predicate_t::PATH) != (pass == 0)) {
+          continue;
+        }
+        if (predicate.key == nullptr ||
+            (predicate.type == predicate_t::STRING &&
+             predicate.str == nullptr) ||
+            predicate.type > predicate_t::CELL) {
+          return false;
+        }
+        if constexpr (Config::INVERTED_INDEXES) {
+          if (predicate.type == predicate_t::STRING &&
+              fdt_strcmp(predicate.key, "device_type") == 0 &&
+              fdt_strcmp(predicate.str, "memory") == 0) {
+            _plan.indexes |= plan_t::INDEX_MEMORY;
+            continue;
+          }
+          if (predicate.type == predicate_t::STRING &&
+              fdt_strcmp(predicate.key, "status") == 0 &&
+              fdt_strcmp(predicate.str, "okay") == 0) {
+            _plan.indexes |= plan_t::INDEX_OKAY;
+            continue;
+          }
+        }
+        _plan.depths[_plan.count] = 0;
+        if (predicate.type == predicate_t::PATH) {
+          if (predicate.key[0] != '/') {
+            return false;
+          }
+          // 每个后面跟着名称的 '/' 是一层
+          size_t depth = 0;
+          for (size_t k = 0; predicate.key[k] != '\0'; k++) {
+            if (predicate.key[k] == '/' && predicate.key[k + 1] != '\0' &&
+                predicate.key[k + 1] != '/') {
+              depth++;
+            }
+          }
+          if (depth >= MAX_DEPTH) {
+            return false;
+          }
+          _plan.depths[_plan.count] = depth;
+        } else if (predicate.type == predicate_t::STRING &&
+                   _plan.compatible == plan_t::MAX_STEPS &&
+                   fdt_strcmp(predicate.key, "compatible") == 0) {
+          _plan.compatible = _plan.count;
+        }
+        _plan.steps[_plan.count++] = predicate;
+      }
+      if (pass == 0) {
+        _plan.props_begin = _plan.count;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief 查找满足 plan 的节点
+   * @param  _plan            compile() 的结果
+   * @param  _nodes           结果数组，保存节点下标
+   * @param  _capacity        结果数组的长度
+   * @return size_t           匹配的节点数，可能大于 _capacity，
+   * 此时只填充前 _capacity 个
+   * @note 只遍历一次节点数组，有倒排索引时跳过不在索引中的节点，
+   * 结果按节点在 dtb 中的顺序排列
+   */
+  size_t select(const plan_t& _plan, uint32_t* _nodes,
+                size_t _capacity) const {
+    return plan_each(_plan, [&](uint32_t _idx, size_t _count) {
+      if (_count < _capacity) {
+        _nodes[_count] = _idx;
+      }
+    });
+  }
+
+  /**
+   * @brief 查找满足 plan 的节点，返回使用的资源
+   * @param  _plan            compile() 的结果
+   * @param  _resource        结果数组
+   * @param  _capacity        结果数组的长度
+   * @param  _types           需要的 resource_t 类型
+   * @return size_t           匹配的节点数，可能大于 _capacity
+   */
+  size_t select(const plan_t& _plan, resource_t* _resource, size_t _capacity,
+                uint8_t _types = resource_t::MEM | resource_t::INTR_NO |
+                                 resource_t::FREQUENCY) const {
+    return plan_each(_plan, [&](uint32_t _idx, size_t _count) {
+      if (_count < _capacity) {
+        fill_node_resource(_resource[_count], nodes.first[_idx], _types);
+      }
+    });
+  }
+
+  /**
+   * @brief 获取 cpu 与 numa 拓扑
+   * @param  _topology        被填充的拓扑信息
+   * @return true             成功
+   * @return false            cpu 或 numa 节点数超出 cpu_topology_t 的容量，
+   * 或 hart id 超过 64 位
+   * @note 只遍历一次节点数组，结果可以直接用于各个 hart 的初始化
+   */
+  bool get_cpu_topology(cpu_topology_t& _topology) const {
+    bool res = true;
+    _topology.cpu_count = 0;
+    _topology.node_count = 1;
+    const prop_t* distance_matrix = nullptr;
+    for (size_t i = 0; i < nodes.second; i++) {
+      const node_t& node = nodes.first[i];
+      // numa 节点数由最大的 numa-node-id 决定，包括 memory 节点
+      auto numa_node_id = get_prop(node, "numa-node-id");
+      if (numa_node_id != nullptr) {
+        size_t id = get_prop_u32(numa_node_id, 0);
+        if (id >= cpu_topology_t::MAX_NUMA_NODES) {
+          res = false;
+        } else if (id >= _topology.node_count) {
+          _topology.node_count = id + 1;
+        }
+      }
+      if (is_cpu_node(node)) {
+        if (_topology.cpu_count >= cpu_topology_t::MAX_CPUS) {
+          res = false;
+          continue;
+        }
+        auto& cpu = _topology.cpus[_topology.cpu_count];
+        if (!fill_cpu(cpu, node)) {
+          res = false;
+          continue;
+        }
+        // 没有 cpu-map 时每个 cpu 作为单独的 core
+        cpu.socket = 0;
+        cpu.cluster = 0;
+        cpu.core = _topology.cpu_count;
+        cpu.thread = 0;
+        _topology.cpu_count++;
+      } else if (node.depth == 2 &&
+                 fdt_strcmp(node_name(node), "distance-map") == 0) {
+        distance_matrix = get_prop(node, "distance-matrix");
+      }
+    }
+    // cpu-map 可能位于 cpu 节点之前，所以在 cpu 全部找到后处理
+    // cpu-map 节点的深度，0 表示不在 cpu-map 中
+    size_t cpu_map_depth = 0;
+    for (size_t i = 0; i < nodes.second; i++) {
+      const node_t& node = nodes.first[i];
+      if (cpu_map_depth == 0 && node.depth == 3 &&
+          fdt_strcmp(node_name(node), "cpu-map") == 0 &&
+          fdt_strcmp(node_name(nodes.first[node.parent]), "cpus") == 0) {
+        cpu_map_depth = node.depth;
+      } else if (cpu_map_depth != 0 && node.depth <= cpu_map_depth) {
+        cpu_map_depth = 0;
+      } else if (cpu_map_depth != 0 && get_prop(node, "cpu") != nullptr) {
+        fill_cpu_map(_topology, i);
+      }
+    }
+    // 默认距离
+    for (size_t from = 0; from < cpu_topology_t::MAX_NUMA_NODES; from++) {
+      for (size_t to = 0; to < cpu_topology_t::MAX_NUMA_NODES; to++) {
+        _topology.distance[from][to] = (from == to)
+                                           ? cpu_topology_t::LOCAL_DISTANCE
+                                           : cpu_topology_t::REMOTE_DISTANCE;
+      }
+    }
+    // distance-matrix 由 <from to distance> 三元组组成，距离是对称的
+    if (distance_matrix != nullptr) {
+      auto cells = (uint32_t*)prop_addr(*distance_matrix);
+      for (size_t i = 0; i + 3 <= distance_matrix->len / 4; i += 3) {
+        auto from = fdt_parser_be32toh(cells[i]);
+        auto to = fdt_parser_be32toh(cells[i + 1]);
+        auto distance = fdt_parser_be32toh(cells[i + 2]);
+        if (from >= cpu_topology_t::MAX_NUMA_NODES ||
+            to >= cpu_topology_t::MAX_NUMA_NODES) {
+          res = false;
+          continue;
+        }
+        _topology.distance[from][to] = distance;
+        _topology.distance[to][from] = distance;
+      }
+    }
+    // 每个 numa 节点的 cpu 掩码
+    for (size_t n = 0; n < cpu_topology_t::MAX_NUMA_NODES; n++) {
+      for (size_t w = 0; w < cpu_topology_t::MASK_WORDS; w++) {
+        _topology.node_cpus[n][w] = 0;
+      }
+    }
+    for (size_t i = 0; i < _topology.cpu_count; i++) {
+      auto numa_node = _topology.cpus[i].numa_node;
+      if (numa_node < cpu_topology_t::MAX_NUMA_NODES) {
+        _topology.node_cpus[numa_node][i / 64] |= 1ULL << (i % 64);
+      }
+    }
+    return res;
+  }
+};
+
+/// 默认配置的索引
+typedef basic_fdt_index<fdt_config_t> fdt_index;
+
+/**
+ * @brief basic_fdt_index 的只读句柄
+ * @note 只保存索引地址，复制开销为 O(1)，多个子系统可以共享同一个索引，
+ * 句柄的生命周期不能超过其指向的索引
+ * @tparam Config 索引配置
+ */
+template <class Config>
+class basic_fdt_view {
+ private:
+  /// 指向的索引
+  const basic_fdt_index<Config>* index;
+
+ public:
+  /**
+   * 构造函数
+   * @param _index 要访问的索引
+   */
+  explicit basic_fdt_view(const basic_fdt_index<Config>& _index)
+      : index(&_index) {}
+
+  /// @name 默认构造/析构函数
+  /// @{
+  basic_fdt_view() : index(nullptr) {}
+  basic_fdt_view(const basic_fdt_view& _fdt_view) = default;
+  basic_fdt_view(basic_fdt_view&& _fdt_view) = default;
+  auto operator=(const basic_fdt_view& _fdt_view)
+      -> basic_fdt_view& = default;
+  auto operator=(basic_fdt_view&& _fdt_view) -> basic_fdt_view& = default;
+  ~basic_fdt_view() = default;
+  /// @}
+
+  /**
+   * @brief 是否指向了索引
+   * @return true            是
+   * @return false           否
+   */
+  bool valid(void) const { return index != nullptr; }
+
+  /// @name 访问索引的查询接口
+  /// @{
+  const basic_fdt_index<Config>* operator->(void) const { return index; }
+  const basic_fdt_index<Config>& operator*(void) const { return *index; }
+  /// @}
+};
+
+/// 默认配置的只读句柄
+typedef basic_fdt_view<fdt_config_t> fdt_view;
+
+/**
+ * @brief 解析 dtb 并持有其索引
+ * @note 复制会复制整个索引，在子系统之间传递时使用 view()
+ * @tparam Config 索引配置
+ */
+template <class Config>
+class basic_fdt_parser final : public basic_fdt_index<Config> {
+ public:
+  /**
+   * 构造函数
+   * @param _dtb_addr dtb 信息地址
+   */
+  explicit basic_fdt_parser(uintptr_t _dtb_addr, uint8_t _flags = 0) {
+    this->dtb_init(_dtb_addr, _flags);
+  }
+
+  /**
+   * 构造函数
+   * @param _validated validate() 的结果
+   * @param _flags     DT_INIT_* 标志
+   */
+  explicit basic_fdt_parser(const fdt_validated_t& _validated,
+                            uint8_t _flags = 0) {
+    this->dtb_init(_validated, _flags);
+  }
+
+  /// @name 默认构造/析构函数
+  /// @{
+  basic_fdt_parser() = default;
+  basic_fdt_parser(const basic_fdt_parser& _fdt_parser) = default;
+  basic_fdt_parser(basic_fdt_parser&& _fdt_parser) = default;
+  auto operator=(const basic_fdt_parser& _fdt_parser)
+      -> basic_fdt_parser& = default;
+  auto operator=(basic_fdt_parser&& _fdt_parser)
+      -> basic_fdt_parser& = default;
+  ~basic_fdt_parser() = default;
+  /// @}
+
+  using basic_fdt_index<Config>::dtb_init;
+  using basic_fdt_index<Config>::rebase;
+  using basic_fdt_index<Config>::stream_begin;
+  using basic_fdt_index<Config>::stream_feed;
+  using basic_fdt_index<Config>::stream_finish;
+  using basic_fdt_index<Config>::update;
+
+  /**
+   * @brief 获取只读句柄
+   * @return basic_fdt_view<Config> 指向本对象索引的句柄
+   */
+  basic_fdt_view<Config> view(void) const {
+    return basic_fdt_view<Config>(*this);
+  }
+};
+
+/// 默认配置的解析器
+typedef basic_fdt_parser<fdt_config_t> fdt_parser;
+
+/**
+ * @brief 在多个 hart 之间共享的索引
+ * @note 由一个 hart 调用 dtb_init() 构建，完成后以 release 语义发布，
+ * 其它 hart 在 ready() 返回 true 之后即可无锁地并发查询
+ * @note 路径与 compatible 的二级索引在第一次使用时由某一个 hart 构建，
+ * 构建期间其它 hart 直接使用线性查找，不会等待
+ * @note 只公开检查 ready() 的查询，其它查询需要通过 view() 获取句柄
+ */
+class fdt_shared_index final : private fdt_index {
+ private:
+  /// 二级索引状态
+  enum lazy_state_t : uint8_t {
+    /// 未构建
+    LAZY_EMPTY = 0,
+    /// 正在由某个 hart 构建
+    LAZY_BUILDING,
+    /// 可以使用
+    LAZY_READY,
+    /// 超出容量，始终使用线性查找
+    LAZY_FAILED,
+  };
+
+  /**
+   * @brief 二级索引项，按 hash 排序
+   */
+  struct hash_entry_t {
+    /// 路径或 compatible 的 fdt_hash
+    uint32_t hash;
+    /// 节点下标
+    uint32_t node;
+  };
+
+  /// compatible 二级索引的容量
+  static constexpr const size_t COMPATIBLE_MAX_COUNT = MAX_NODES_COUNT * 4;
+
+  /// 索引是否已发布
+  std::atomic<bool> published;
+  /// 路径二级索引，每个节点一项
+  mutable std::atomic<uint8_t> paths_state;
+  mutable hash_entry_t paths[MAX_NODES_COUNT];
+  /// compatible 二级索引，compatible 中的每个字符串一项
+  mutable std::atomic<uint8_t> compatibles_state;
+  mutable hash_entry_t compatibles[COMPATIBLE_MAX_COUNT];
+  mutable size_t compatibles_count;
+
+  /**
+   * @brief 按 hash 排序，hash 相同时保持节点顺序
+   * @param  _entries        要排序的数组
+   * @param  _count          数组长度
+   */
+  static void sort_entries(hash_entry_t* _entries, size_t _count) {
+    // 插入排序，节点数较少且大多已经有序
+    for (size_t i = 1; i < _count; i++) {
+      auto entry = _entries[i];
+      size_t j = i;
+      while (j > 0 && _entries[j - 1].hash > entry.hash) {
+        _entries[j] = _entries[j - 1];
+        j--;
+      }
+      _entries[j] = entry;
+    }
+    return;
+  }
+
+  /**
+   * @brief 查找第一个 hash 等于 _hash 的项
+   * @param  _entries        有序数组
+   * @param  _count          数组长度
+   * @param  _hash           要查找的 hash
+   * @return size_t          第一个不小于 _hash 的项的下标
+   */
+  static size_t lower_bound(const hash_entry_t* _entries, size_t _count,
+                            uint32_t _hash) {
+    size_t lo = 0;
+    size_t hi = _count;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (_entries[mid].hash < _hash) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  /**
+   * @brief 尝试获取二级索引，未构建时尝试由当前 hart 构建
+   * @param  _state          二级索引状态
+   * @param  _build          构建函数
+   * @return true            可以使用
+   * @return false           正在由其它 hart 构建或超出容量
+   */
+  bool acquire_lazy(std::atomic<uint8_t>& _state,
+                    bool (fdt_shared_index::*_build)(void) const) const {
+    auto state = _state.load(std::memory_order_acquire);
+    if (state == LAZY_READY) {
+      return true;
+    }
+    if (state != LAZY_EMPTY) {
+      return false;
+    }
+    // 只有一个 hart 能从 LAZY_EMPTY 切换到 LAZY_BUILDING
+    uint8_t expected = LAZY_EMPTY;
+    if (!_state.compare_exchange_strong(expected, LAZY_BUILDING,
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+      return expected == LAZY_READY;
+    }
+    // 构建完成后以 release 语义发布，其它 hart acquire 后可以看到数组内容
+    auto res = (this->*_build)();
+    _state.store(res ? LAZY_READY : LAZY_FAILED, std::memory_order_release);
+    return res;
+  }
+
+  /**
+   * @brief 构建路径二级索引
+   * @return true            成功
+   * @return false           失败
+   */
+  bool build_paths(void) const {
+    // 节点按先序排列，父节点的 hash 总是先计算出来
+    uint32_t hashes[MAX_NODES_COUNT];
+    for (size_t i = 0; i < nodes.second; i++) {
+      const node_t& node = nodes.first[i];
+      hashes[i] = (node.parent == NO_NODE)
+                      ? fdt_hash("")
+                      : fdt_hash(node_name(node),
+                                 fdt_hash("/", hashes[node.parent]));
+      paths[i].hash = hashes[i];
+      paths[i].node = i;
+    }
+    sort_entries(paths, nodes.second);
+    return true;
+  }
+
+  /**
+   * @brief 构建 compatible 二级索引
+   * @return true            成功
+   * @return false           compatible 总数超出容量
+   */
+  bool build_compatibles(void) const {
+    size_t count = 0;
+    for (size_t i = 0; i < nodes.second; i++) {
+      auto compatible = get_prop(nodes.first[i], "compatible");
+      if (compatible == nullptr) {
+        continue;
+      }
+      auto str = (const char*)prop_addr(*compatible);
+      for (size_t j = 0; j < compatible->len;) {
+        // 不是以 '\0' 结尾的字符串时停止，不读取属性之外的数据
+        auto len = str_len(str + j, compatible->len - j);
+        if (len == NO_STR) {
+          break;
+        }
+        if (count >= COMPATIBLE_MAX_COUNT) {
+          return false;
+        }
+        compatibles[count].hash = fdt_hash(str + j);
+        compatibles[count].node = i;
+        count++;
+        j += len + 1;
+      }
+    }
+    sort_entries(compatibles, count);
+    compatibles_count = count;
+    return true;
+  }
+
+  /**
+   * @brief 通过路径二级索引寻找节点
+   * @param  _path            路径
+   * @return const node_t*    找到的节点
+   * @note 省略单元地址的路径无法通过 hash 找到，此时使用线性查找
+   */
+  const node_t* find_node(const char* _path) const {
+    if (acquire_lazy(paths_state, &fdt_shared_index::build_paths)) {
+      // 去掉末尾的 '/'，根节点的路径 hash 为空字符串的 hash
+      uint32_t hash = fdt_hash("");
+      size_t len = fdt_strlen(_path);
+      if (len > 0 && _path[len - 1] == '/') {
+        len--;
+      }
+      for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)_path[i]) * 0x01000193;
+      }
+      for (auto i = lower_bound(paths, nodes.second, hash);
+           i < nodes.second && paths[i].hash == hash; i++) {
+        if (path_equal(paths[i].node, _path)) {
+          return &nodes.first[paths[i].node];
+        }
+      }
+    }
+    return find_node_via_path(_path);
+  }
+
+  /**
+   * @brief 对满足 plan 的每个节点调用 _fn
+   * @param  _plan           compile() 的结果
+   * @param  _fn             以节点下标为参数
+   * @return size_t          匹配的节点数
+   * @note 有 compatible 条件时只检查 compatible 二级索引中对应的节点，
+   * 同一 hash 的项按节点顺序排列，结果与 fdt_index::select() 相同
+   */
+  template <class F>
+  size_t shared_plan_each(const plan_t& _plan, F _fn) const {
+    if (_plan.compatible == plan_t::MAX_STEPS ||
+        !acquire_lazy(compatibles_state,
+                      &fdt_shared_index::build_compatibles)) {
+      return plan_each(_plan, _fn);
+    }
+    size_t res = 0;
+    uint32_t last = NO_NODE;
+    auto hash = fdt_hash(_plan.steps[_plan.compatible].str);
+    for (auto i = lower_bound(compatibles, compatibles_count, hash);
+         i < compatibles_count && compatibles[i].hash == hash; i++) {
+      auto idx = compatibles[i].node;
+      if (idx == last) {
+        continue;
+      }
+      last = idx;
+      // plan_match() 会再次比较 compatible，排除 hash 冲突
+      if (((plan_candidates(_plan, idx / 64) >> (idx % 64)) & 1) &&
+          plan_match(_plan, idx)) {
+        _fn(idx, res);
+        res++;
+      }
+    }
+    return res;
+  }
+
+ public:
+  using fdt_index::compile;
+  using fdt_index::plan_t;
+  using fdt_index::predicate_t;
+
+  /**
+   * 构造函数
+   * @param _dtb_addr dtb 信息地址
+   * @param _flags    DT_INIT_* 标志
+   */
+  explicit fdt_shared_index(uintptr_t _dtb_addr, uint8_t _flags = 0)
+      : fdt_shared_index() {
+    dtb_init(_dtb_addr, _flags);
+  }
+
+  /**
+   * 构造函数
+   * @param _validated validate() 的结果
+   * @param _flags     DT_INIT_* 标志
+   */
+  explicit fdt_shared_index(const fdt_validated_t& _validated,
+                            uint8_t _flags = 0)
+      : fdt_shared_index() {
+    dtb_init(_validated, _flags);
+  }
+
+  /// @name 构造/析构函数
+  /// @{
+  fdt_shared_index()
+      : published(false),
+        paths_state(LAZY_EMPTY),
+        compatibles_state(LAZY_EMPTY),
+        compatibles_count(0) {}
+  fdt_shared_index(const fdt_shared_index& _fdt_shared_index) = delete;
+  fdt_shared_index(fdt_shared_index&& _fdt_shared_index) = delete;
+  auto operator=(const fdt_shared_index& _fdt_shared_index)
+      -> fdt_shared_index& = delete;
+  auto operator=(fdt_shared_index&& _fdt_shared_index)
+      -> fdt_shared_index& = delete;
+  ~fdt_shared_index() = default;
+  /// @}
+
+  /**
+   * @brief 构建并发布索引，成功后不能再调用
+   * @param _dtb_addr dtb 二进制信息地址
+   * @param _flags           DT_INIT_* 标志
+   * @return true            成功
+   * @return false           失败或已发布，失败时不发布
+   */
+  bool dtb_init(uintptr_t _dtb_addr, uint8_t _flags = 0) {
+    // 发布后其它 hart 可能正在读取，索引不能再修改
+    if (published.load(std::memory_order_acquire)) {
+      return false;
+    }
+    auto res = fdt_index::dtb_init(_dtb_addr, _flags);
+    if (res) {
+      published.store(true, std::memory_order_release);
+    }
+    return res;
+  }
+
+  /**
+   * @brief 构建并发布已检查的 dtb 的索引，成功后不能再调用
+   * @param _validated       validate() 的结果
+   * @param _flags           DT_INIT_* 标志
+   * @return true            成功
+   * @return false           超出索引容量或已发布，失败时不发布
+   */
+  bool dtb_init(const fdt_validated_t& _validated, uint8_t _flags = 0) {
+    if (published.load(std::memory_order_acquire)) {
+      return false;
+    }
+    auto res = fdt_index::dtb_init(_validated, _flags);
+    if (res) {
+      published.store(true, std::memory_order_release);
+    }
+    return res;
+  }
+
+  /**
+   * @brief 索引是否已发布，返回 true 后当前 hart 可以看到完整的索引
+   * @return true            已发布
+   * @return false           未发布
+   */
+  bool ready(void) const { return published.load(std::memory_order_acquire); }
+
+  /**
+   * @brief 获取只读句柄
+   * @return fdt_view         未发布时返回无效的句柄
+   */
+  fdt_view view(void) const { return ready() ? fdt_view(*this) : fdt_view(); }
+
+  /**
+   * @brief 根据路径查找节点，返回使用的资源
+   * @param  _path            节点路径
+   * @param  _resource        资源
+   * @return true             成功
+   * @return false            未发布或没有找到
+   */
+  bool find_via_path(const char* _path, resource_t* _resource) const {
+    if (!ready()) {
+      return false;
+    }
+    auto node = find_node(_path);
+    if (node == nullptr) {
+      return false;
+    }
+    fill_node_resource(_resource[0], *node);
+    return true;
+  }
+
+  /**
+   * @brief 根据 compatible 查找节点
+   * @param  _compatible      compatible 中的任意一项
+   * @param  _resource        结果数组
+   * @return size_t           _resource 长度，未发布时为 0
+   */
+  size_t find_via_compatible(const char* _compatible,
+                             resource_t* _resource) const {
+    if (!ready()) {
+      return 0;
+    }
+    if (!acquire_lazy(compatibles_state,
+                      &fdt_shared_index::build_compatibles)) {
+      return fdt_index::find_via_compatible(_compatible, _resource);
+    }
+    size_t res = 0;
+    // 上一个匹配的节点，同一节点的 compatible 中可能有重复项
+    uint32_t last = NO_NODE;
+    auto hash = fdt_hash(_compatible);
+    for (auto i = lower_bound(compatibles, compatibles_count, hash);
+         i < compatibles_count && compatibles[i].hash == hash; i++) {
+      const node_t& node = nodes.first[compatibles[i].node];
+      // 排除 hash 冲突
+      if (compatibles[i].node == last ||
+          !prop_has_string(*get_prop(node, "compatible"), _compatible)) {
+        continue;
+      }
+      fill_node_resource(_resource[res], node);
+      last = compatibles[i].node;
+      res++;
+    }
+    return res;
+  }
+
+  /**
+   * @brief 查找满足 plan 的节点
+   * @param  _plan            compile() 的结果
+   * @param  _nodes           结果数组，保存节点下标
+   * @param  _capacity        结果数组的长度
+   * @return size_t           匹配的节点数，未发布时为 0
+   */
+  size_t select(const plan_t& _plan, uint32_t* _nodes,
+                size_t _capacity) const {
+    if (!ready()) {
+      return 0;
+    }
+    return shared_plan_each(_plan, [&](uint32_t _idx, size_t _count) {
+      if (_count < _capacity) {
+        _nodes[_count] = _idx;
+      }
+    });
+  }
+
+  /**
+   * @brief 查找满足 plan 的节点，返回使用的资源
+   * @param  _plan            compile() 的结果
+   * @param  _resource        结果数组
+   * @param  _capacity        结果数组的长度
+   * @param  _types           需要的 resource_t 类型
+   * @return size_t           匹配的节点数，未发布时为 0
+   */
+  size_t select(const plan_t& _plan, resource_t* _resource, size_t _capacity,
+                uint8_t _types = resource_t::MEM | resource_t::INTR_NO |
+                                 resource_t::FREQUENCY) const {
+    if (!ready()) {
+      return 0;
+    }
+    return shared_plan_each(_plan, [&](uint32_t _idx, size_t _count) {
+      if (_count < _capacity) {
+        fill_node_resource(_resource[_count], nodes.first[_idx], _types);
+      }
+    });
+  }
+};
+
+// 索引中只有下标与偏移，可以按字节复制
+static_assert(std::is_trivially_copy_constructible<fdt_index>::value &&
+                  std::is_trivially_destructible<fdt_index>::value,
+              "fdt_index must stay relocatable");
+static_assert(
+    std::is_trivially_copy_constructible<
+        basic_fdt_index<fdt_tiny_config_t>>::value &&
+        std::is_trivially_destructible<
+            basic_fdt_index<fdt_tiny_config_t>>::value,
+    "basic_fdt_index must stay relocatable");
 
 }  // namespace FDT_PARSER
 
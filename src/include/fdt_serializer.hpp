@@ -0,0 +1,738 @@
+
+// This file is a part of MRNIU/fdt-parser
+// (https://github.com/MRNIU/fdt-parser).
+//
+// fdt_serializer.hpp for MRNIU/fdt-parser.
+
+#ifndef FDT_PARSER_SRC_INCLUDE_FDT_SERIALIZER_H
+#define FDT_PARSER_SRC_INCLUDE_FDT_SERIALIZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fdt_parser.hpp"
+
+namespace FDT_PARSER {
+
+/**
+ * @brief 将 dtb 输出为 DTS 源码或 JSON
+ * @note 直接遍历 dtb 的 token，不受索引容量限制，输出先写入固定大小的缓冲区，
+ * 满了之后交给 sink，不使用堆
+ * @note 默认输出与 dtc 1.6 的 `dtc -I dtb -O dts` 相同，
+ * 未知属性的类型与 dtc 一样根据内容猜测
+ */
+class fdt_serializer {
+ public:
+  /**
+   * @brief 输出回调
+   * @param  _data           要输出的数据，不以 '\0' 结尾
+   * @param  _len            数据长度
+   * @param  _ctx            调用者提供的参数
+   * @return true            成功
+   * @return false           失败，停止输出
+   */
+  typedef bool (*sink_t)(const char* _data, size_t _len, void* _ctx);
+
+  /**
+   * @brief 输出格式
+   */
+  enum format_t : uint8_t {
+    /// dts 源码
+    FORMAT_DTS = 0,
+    /// json，根节点为最外层对象，子节点为以节点名为键的对象
+    FORMAT_JSON,
+  };
+
+  // 用于控制输出内容
+  /// phandle 输出为 phandle_N 形式的标签，字符串列表分开输出
+  static constexpr const uint8_t SERIALIZE_LABELS = 0x01;
+
+  /// 缓冲区大小
+  static constexpr const size_t BUFFER_SIZE = 1024;
+
+ private:
+  using idx = fdt_index;
+
+  /**
+   * @brief 属性值的输出类型
+   */
+  enum value_t : uint8_t {
+    /// 空
+    VALUE_EMPTY = 0,
+    /// 以 '\0' 分隔的字符串
+    VALUE_STRING,
+    /// 32 位整数
+    VALUE_CELLS,
+    /// 字节
+    VALUE_BYTES,
+    /// phandle 引用
+    VALUE_PHANDLE,
+  };
+
+  /// 输出回调
+  sink_t sink;
+  /// 回调参数
+  void* ctx;
+  /// 输出选项
+  uint8_t flags;
+  /// 回调是否一直成功
+  bool ok;
+  /// 缓冲区已使用的长度
+  size_t used;
+  /// 缓冲区
+  char buffer[BUFFER_SIZE];
+
+  /**
+   * @brief 将缓冲区交给 sink
+   */
+  void flush(void) {
+    if (used != 0 && ok) {
+      ok = sink(buffer, used, ctx);
+    }
+    used = 0;
+  }
+
+  /**
+   * @brief 输出一个字符
+   * @param  _c              要输出的字符
+   */
+  void put(char _c) {
+    if (used == BUFFER_SIZE) {
+      flush();
+    }
+    buffer[used++] = _c;
+  }
+
+  /**
+   * @brief 输出 _len 个字符
+   * @param  _s              要输出的字符
+   * @param  _len            长度
+   */
+  void write(const char* _s, size_t _len) {
+    while (_len != 0) {
+      if (used == BUFFER_SIZE) {
+        flush();
+      }
+      auto count = BUFFER_SIZE - used;
+      if (count > _len) {
+        count = _len;
+      }
+      for (size_t i = 0; i < count; i++) {
+        buffer[used + i] = _s[i];
+      }
+      used += count;
+      _s += count;
+      _len -= count;
+    }
+  }
+
+  /**
+   * @brief 输出以 '\0' 结尾的字符串
+   * @param  _s              要输出的字符串
+   */
+  void write(const char* _s) { write(_s, fdt_strlen(_s)); }
+
+  /**
+   * @brief 输出十六进制数，不带 0x
+   * @param  _val            要输出的数
+   * @param  _digits         最少位数
+   */
+  void put_hex(uint64_t _val, size_t _digits) {
+    char tmp[16];
+    size_t len = 0;
+    do {
+      tmp[len++] = "0123456789abcdef"[_val & 0xF];
+      _val >>= 4;
+    } while (_val != 0 || len < _digits);
+    while (len != 0) {
+      put(tmp[--len]);
+    }
+  }
+
+  /**
+   * @brief 输出十进制数
+   * @param  _val            要输出的数
+   */
+  void put_dec(uint64_t _val) {
+    char tmp[20];
+    size_t len = 0;
+    do {
+      tmp[len++] = (char)('0' + _val % 10);
+      _val /= 10;
+    } while (_val != 0);
+    while (len != 0) {
+      put(tmp[--len]);
+    }
+  }
+
+  /**
+   * @brief 输出缩进
+   * @param  _depth          层数
+   * @param  _json           json 使用两个空格，dts 使用 tab
+   */
+  void indent(size_t _depth, bool _json) {
+    for (size_t i = 0; i < _depth; i++) {
+      if (_json) {
+        write("  ", 2);
+      } else {
+        put('\t');
+      }
+    }
+  }
+
+  /**
+   * @brief 输出 phandle 对应的标签
+   * @param  _phandle        phandle 值
+   */
+  void put_label(uint32_t _phandle) {
+    write("phandle_");
+    put_dec(_phandle);
+  }
+
+  /**
+   * @brief 是否是 dtc 认为的字符串中可以出现的字符
+   * @param  _c              字符
+   * @return true            是
+   * @return false           否
+   */
+  static bool is_string_char(uint8_t _c) {
+    return (_c >= 0x20 && _c < 0x7F) || _c == '\0' ||
+           (_c >= '\a' && _c <= '\r');
+  }
+
+  /**
+   * @brief 是否可以作为字符串输出
+   * @param  _data           属性数据
+   * @param  _len            属性长度
+   * @return size_t          字符串个数，不是字符串时为 0
+   */
+  static size_t count_strings(const uint8_t* _data, uint32_t _len) {
+    if (_len == 0 || _data[_len - 1] != '\0') {
+      return 0;
+    }
+    size_t nul = 0;
+    for (uint32_t i = 0; i < _len; i++) {
+      if (!is_string_char(_data[i])) {
+        return 0;
+      }
+      if (_data[i] == '\0') {
+        nul++;
+      }
+    }
+    return nul;
+  }
+
+  /**
+   * @brief 与 dtc 相同的类型猜测
+   * @param  _data           属性数据
+   * @param  _len            属性长度
+   * @return value_t         输出类型
+   */
+  static value_t guess_value(const uint8_t* _data, uint32_t _len) {
+    auto nul = count_strings(_data, _len);
+    // 空字符不能多于其它字符
+    if (nul != 0 && nul <= _len - nul) {
+      return VALUE_STRING;
+    }
+    if (_len % 4 == 0) {
+      return VALUE_CELLS;
+    }
+    return VALUE_BYTES;
+  }
+
+  /**
+   * @brief 决定属性的输出类型
+   * @param  _name           属性名
+   * @param  _data           属性数据
+   * @param  _len            属性长度
+   * @return value_t         输出类型
+   * @note 优先使用 get_fmt() 的格式，数据与格式不符时再猜测
+   */
+  value_t get_value_type(const char* _name, const uint8_t* _data,
+                         uint32_t _len) const {
+    if (_len == 0) {
+      return VALUE_EMPTY;
+    }
+    switch (idx::get_fmt(_name)) {
+      case idx::FMT_STRING:
+      case idx::FMT_STRINGLIST: {
+        if (count_strings(_data, _len) != 0) {
+          return VALUE_STRING;
+        }
+        break;
+      }
+      case idx::FMT_U32:
+      case idx::FMT_U64:
+      case idx::FMT_REG:
+      case idx::FMT_RANGES: {
+        if (_len % 4 == 0) {
+          return VALUE_CELLS;
+        }
+        break;
+      }
+      case idx::FMT_PHANDLE: {
+        if (_len == 4) {
+          return (flags & SERIALIZE_LABELS) ? VALUE_PHANDLE : VALUE_CELLS;
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    return guess_value(_data, _len);
+  }
+
+  /**
+   * @brief 输出 dts 字符串中的一个字符
+   * @param  _c              字符
+   */
+  void put_dts_char(uint8_t _c) {
+    switch (_c) {
+      case '\a': {
+        write("\\a", 2);
+        break;
+      }
+      case '\b': {
+        write("\\b", 2);
+        break;
+      }
+      case '\t': {
+        write("\\t", 2);
+        break;
+      }
+      case '\n': {
+        write("\\n", 2);
+        break;
+      }
+      case '\v': {
+        write("\\v", 2);
+        break;
+      }
+      case '\f': {
+        write("\\f", 2);
+        break;
+      }
+      case '\r': {
+        write("\\r", 2);
+        break;
+      }
+      case '\\': {
+        write("\\\\", 2);
+        break;
+      }
+      case '\"': {
+        write("\\\"", 2);
+        break;
+      }
+      case '\'': {
+        write("\\\'", 2);
+        break;
+      }
+      case '\0': {
+        write("\\0", 2);
+        break;
+      }
+      default: {
+        if (_c >= 0x20 && _c < 0x7F) {
+          put((char)_c);
+        } else {
+          write("\\x", 2);
+          put_hex(_c, 2);
+        }
+        break;
+      }
+    }
+  }
+
+  /**
+   * @brief 输出 json 字符串中的一个字符
+   * @param  _c              字符
+   * @note 大于 0x7F 的字节按 latin-1 输出
+   */
+  void put_json_char(uint8_t _c) {
+    if (_c == '\"' || _c == '\\') {
+      put('\\');
+      put((char)_c);
+    } else if (_c >= 0x20 && _c < 0x7F) {
+      put((char)_c);
+    } else {
+      write("\\u00", 4);
+      put_hex(_c, 2);
+    }
+  }
+
+  /**
+   * @brief 输出 json 字符串，包括引号
+   * @param  _s              字符串
+   * @param  _len            长度
+   */
+  void put_json_string(const uint8_t* _s, size_t _len) {
+    put('\"');
+    for (size_t i = 0; i < _len; i++) {
+      put_json_char(_s[i]);
+    }
+    put('\"');
+  }
+
+  /**
+   * @brief 输出 dts 格式的属性值
+   * @param  _type           输出类型
+   * @param  _data           属性数据
+   * @param  _len            属性长度
+   */
+  void put_dts_value(value_t _type, const uint8_t* _data, uint32_t _len) {
+    switch (_type) {
+      case VALUE_STRING: {
+        put('\"');
+        for (uint32_t i = 0; i + 1 < _len; i++) {
+          // 使用标签时每个字符串单独输出
+          if (_data[i] == '\0' && (flags & SERIALIZE_LABELS)) {
+            write("\", \"", 4);
+          } else {
+            put_dts_char(_data[i]);
+          }
+        }
+        put('\"');
+        break;
+      }
+      case VALUE_CELLS: {
+        put('<');
+        for (uint32_t i = 0; i < _len; i += 4) {
+          if (i != 0) {
+            put(' ');
+          }
+          write("0x", 2);
+          put_hex(fdt_parser_be32toh(*(const uint32_t*)(_data + i)), 2);
+        }
+        put('>');
+        break;
+      }
+      case VALUE_BYTES: {
+        put('[');
+        for (uint32_t i = 0; i < _len; i++) {
+          if (i != 0) {
+            put(' ');
+          }
+          put_hex(_data[i], 2);
+        }
+        put(']');
+        break;
+      }
+      case VALUE_PHANDLE: {
+        write("<&", 2);
+        put_label(fdt_parser_be32toh(*(const uint32_t*)_data));
+        put('>');
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  /**
+   * @brief 输出 json 格式的属性值
+   * @param  _type           输出类型
+   * @param  _data           属性数据
+   * @param  _len            属性长度
+   * @note 空属性为 true，单个字符串为字符串，多个字符串、整数与字节为数组
+   */
+  void put_json_value(value_t _type, const uint8_t* _data, uint32_t _len) {
+    switch (_type) {
+      case VALUE_EMPTY: {
+        write("true", 4);
+        break;
+      }
+      case VALUE_STRING: {
+        auto many = count_strings(_data, _len) > 1;
+        if (many) {
+          put('[');
+        }
+        uint32_t start = 0;
+        for (uint32_t i = 0; i < _len; i++) {
+          if (_data[i] == '\0') {
+            if (start != 0) {
+              write(", ", 2);
+            }
+            put_json_string(_data + start, i - start);
+            start = i + 1;
+          }
+        }
+        if (many) {
+          put(']');
+        }
+        break;
+      }
+      case VALUE_CELLS: {
+        put('[');
+        for (uint32_t i = 0; i < _len; i += 4) {
+          if (i != 0) {
+            write(", ", 2);
+          }
+          put_dec(fdt_parser_be32toh(*(const uint32_t*)(_data + i)));
+        }
+        put(']');
+        break;
+      }
+      case VALUE_BYTES: {
+        put('[');
+        for (uint32_t i = 0; i < _len; i++) {
+          if (i != 0) {
+            write(", ", 2);
+          }
+          put_dec(_data[i]);
+        }
+        put(']');
+        break;
+      }
+      case VALUE_PHANDLE: {
+        write("\"&", 2);
+        put_label(fdt_parser_be32toh(*(const uint32_t*)_data));
+        put('\"');
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  /**
+   * @brief 查找节点自身的 phandle
+   * @param  _addr           节点第一个属性或 FDT_NOP 的地址
+   * @param  _str            字符区地址
+   * @return uint32_t        phandle，没有时为 0
+   * @note 属性总是在子节点之前，只需要向后查看到第一个非属性 token
+   */
+  static uint32_t find_phandle(const uint32_t* _addr, uintptr_t _str) {
+    while (1) {
+      auto token = fdt_parser_be32toh(_addr[0]);
+      if (token == idx::FDT_NOP) {
+        _addr++;
+      } else if (token == idx::FDT_PROP) {
+        auto len = fdt_parser_be32toh(_addr[1]);
+        auto name = (const char*)(_str + fdt_parser_be32toh(_addr[2]));
+        if (len == 4 && (fdt_strcmp(name, "phandle") == 0 ||
+                         fdt_strcmp(name, "linux,phandle") == 0)) {
+          return fdt_parser_be32toh(_addr[3]);
+        }
+        _addr += 3 + align_up_power_of_two(len, 4) / 4;
+      } else {
+        break;
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * @brief 输出内存保留区
+   * @param  _entry          第一项地址
+   * @param  _json           是否为 json
+   * @return true            输出了至少一项
+   * @return false           保留区为空
+   */
+  bool put_mem_reserved(const idx::fdt_reserve_entry_t* _entry, bool _json) {
+    bool any = false;
+    for (; _entry->addr_be || _entry->addr_le || _entry->size_be ||
+           _entry->size_le;
+         _entry++) {
+      auto addr = ((uint64_t)fdt_parser_be32toh(_entry->addr_be) << 32) |
+                  fdt_parser_be32toh(_entry->addr_le);
+      auto size = ((uint64_t)fdt_parser_be32toh(_entry->size_be) << 32) |
+                  fdt_parser_be32toh(_entry->size_le);
+      if (_json) {
+        write(any ? ",\n" : "  \"/memreserve/\": [\n");
+        indent(2, true);
+        put('[');
+        put_dec(addr);
+        write(", ", 2);
+        put_dec(size);
+        put(']');
+      } else {
+        write("/memreserve/\t0x");
+        put_hex(addr, 16);
+        write(" 0x", 3);
+        put_hex(size, 16);
+        write(";\n", 2);
+      }
+      any = true;
+    }
+    if (any && _json) {
+      put('\n');
+      indent(1, true);
+      put(']');
+    }
+    return any;
+  }
+
+ public:
+  /**
+   * 构造函数
+   * @param _sink 输出回调
+   * @param _ctx 传递给 _sink 的参数
+   * @param _flags 输出选项
+   */
+  fdt_serializer(sink_t _sink, void* _ctx, uint8_t _flags = 0)
+      : sink(_sink), ctx(_ctx), flags(_flags), ok(true), used(0) {}
+
+  /// @name 默认构造/析构函数
+  /// @{
+  fdt_serializer(const fdt_serializer& _fdt_serializer) = delete;
+  fdt_serializer(fdt_serializer&& _fdt_serializer) = delete;
+  auto operator=(const fdt_serializer& _fdt_serializer)
+      -> fdt_serializer& = delete;
+  auto operator=(fdt_serializer&& _fdt_serializer) -> fdt_serializer& = delete;
+  ~fdt_serializer() = default;
+  /// @}
+
+  /**
+   * @brief 输出已检查的 dtb，不再检查边界
+   * @param  _validated      fdt_index::validate() 的结果
+   * @param  _format         输出格式
+   * @return true            成功
+   * @return false           没有通过检查或 sink 返回 false
+   * @note 不受索引容量限制，超出容量的 dtb 也可以输出
+   */
+  bool serialize(const fdt_validated_t& _validated, format_t _format) {
+    if (!_validated.valid()) {
+      return false;
+    }
+    auto dtb_addr = _validated.dtb_addr();
+    auto header = (const idx::fdt_header_t*)dtb_addr;
+    ok = true;
+    used = 0;
+    auto json = _format == FORMAT_JSON;
+    auto addr = (const uint32_t*)(dtb_addr +
+                                  fdt_parser_be32toh(header->off_dt_struct));
+    auto str = dtb_addr + fdt_parser_be32toh(header->off_dt_strings);
+    auto reserved =
+        (const idx::fdt_reserve_entry_t*)(dtb_addr +
+                                          fdt_parser_be32toh(
+                                              header->off_mem_rsvmap));
+    // 当前所在的层数，根节点内为 1
+    size_t depth = 0;
+    // json 中当前对象还没有成员
+    bool first = true;
+    if (json) {
+      write("{\n", 2);
+      first = !put_mem_reserved(reserved, true);
+    } else {
+      write("/dts-v1/;\n\n");
+      if (put_mem_reserved(reserved, false)) {
+        put('\n');
+      }
+    }
+    while (ok) {
+      switch (fdt_parser_be32toh(addr[0])) {
+        case idx::FDT_BEGIN_NODE: {
+          auto name = (const char*)(addr + 1);
+          auto name_len = fdt_strlen(name);
+          addr += 1 + align_up_power_of_two(name_len + 1, 4) / 4;
+          if (json) {
+            // 根节点就是最外层对象，之前可能已经输出了保留区
+            if (depth != 0) {
+              write(first ? "" : ",\n");
+              indent(depth, true);
+              put_json_string((const uint8_t*)name, name_len);
+              write(": {\n", 4);
+              first = true;
+            }
+          } else {
+            if (depth != 0) {
+              put('\n');
+            }
+            indent(depth, false);
+            if (flags & SERIALIZE_LABELS) {
+              auto phandle = find_phandle(addr, str);
+              if (phandle != 0) {
+                put_label(phandle);
+                write(": ", 2);
+              }
+            }
+            if (depth == 0) {
+              put('/');
+            } else {
+              write(name, name_len);
+            }
+            write(" {\n", 3);
+          }
+          depth++;
+          break;
+        }
+        case idx::FDT_END_NODE: {
+          depth--;
+          if (json) {
+            if (!first) {
+              put('\n');
+            }
+            indent(depth, true);
+            put('}');
+            first = false;
+          } else {
+            indent(depth, false);
+            write("};\n", 3);
+          }
+          addr++;
+          break;
+        }
+        case idx::FDT_PROP: {
+          auto len = fdt_parser_be32toh(addr[1]);
+          auto name = (const char*)(str + fdt_parser_be32toh(addr[2]));
+          auto data = (const uint8_t*)(addr + 3);
+          auto type = get_value_type(name, data, len);
+          if (json) {
+            write(first ? "" : ",\n");
+            indent(depth, true);
+            put_json_string((const uint8_t*)name, fdt_strlen(name));
+            write(": ", 2);
+            put_json_value(type, data, len);
+            first = false;
+          } else {
+            indent(depth, false);
+            write(name);
+            if (type != VALUE_EMPTY) {
+              write(" = ", 3);
+              put_dts_value(type, data, len);
+            }
+            write(";\n", 2);
+          }
+          addr += 3 + align_up_power_of_two(len, 4) / 4;
+          break;
+        }
+        case idx::FDT_END: {
+          if (json) {
+            put('\n');
+          }
+          flush();
+          return ok;
+        }
+        default: {
+          // FDT_NOP
+          addr++;
+          break;
+        }
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief 检查并输出整个 dtb
+   * @param  dtb_addr       dtb 二进制信息地址
+   * @param  _format         输出格式
+   * @return true            成功
+   * @return false           dtb 格式错误或 sink 返回 false
+   */
+  bool serialize(uintptr_t _dtb_addr, format_t _format) {
+    fdt_validated_t validated;
+    if (!idx::validate(_dtb_addr, validated)) {
+      return false;
+    }
+    return serialize(validated, _format);
+  }
+};
+
+}  // namespace FDT_PARSER
+
+#endif /* FDT_PARSER_SRC_INCLUDE_FDT_SERIALIZER_H */
@@ -0,0 +1,286 @@
+
+// This file is a part of MRNIU/fdt-parser
+// (https://github.com/MRNIU/fdt-parser).
+//
+// bench.cpp for MRNIU/fdt-parser.
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "fdt_decompressor.hpp"
+#include "fdt_mmap.hpp"
+#include "fdt_parser.hpp"
+
+namespace {
+
+using FDT_PARSER::fdt_index;
+using FDT_PARSER::resource_t;
+using query_t = fdt_index::query_t;
+
+/// 每项测试的重复次数
+constexpr size_t ROUNDS = 20000;
+
+/// 防止结果被优化掉
+volatile uintptr_t sink;
+
+/**
+ * @brief 使编译器认为 _p 指向的内存被读写，避免被测代码被优化掉
+ * @param  _p              对象地址
+ */
+void escape(void* _p) { asm volatile("" : : "g"(_p) : "memory"); }
+
+/**
+ * @brief 运行 _fn ROUNDS 次并输出平均耗时
+ * @param  _name           测试名
+ * @param  _fn             被测函数
+ * @return double          每次的平均耗时，单位 ns
+ */
+template <class F>
+double measure(const char* _name, F _fn) {
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ROUNDS; i++) {
+    _fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration<double, std::nano>(end - begin).count() /
+            ROUNDS;
+  printf("%-28s %10.1f ns\n", _name, ns);
+  return ns;
+}
+
+/// 启动时常见的一组查询
+struct bringup_t {
+  resource_t memory[1];
+  resource_t clint[1];
+  resource_t plic[1];
+  resource_t uart[1];
+  resource_t rtc[1];
+  resource_t test[1];
+  resource_t flash[1];
+  resource_t cpus[1];
+  resource_t virtio[8];
+};
+
+/**
+ * @brief 逐个调用 find_via_*
+ * @param  _index          索引
+ * @param  _out            结果
+ */
+void sequential(const fdt_index& _index, bringup_t& _out) {
+  _index.find_via_prefix("memory@", _out.memory);
+  _index.find_via_prefix("clint@", _out.clint);
+  _index.find_via_prefix("plic@", _out.plic);
+  _index.find_via_path("/soc/uart@10000000", _out.uart);
+  _index.find_via_prefix("rtc@", _out.rtc);
+  _index.find_via_compatible("sifive,test0", _out.test);
+  _index.find_via_prefix("flash@", _out.flash);
+  _index.find_via_prefix("cpus", _out.cpus);
+  _index.find_via_compatible("virtio,mmio", _out.virtio);
+}
+
+/**
+ * @brief 使用 find_batch 一次完成
+ * @param  _index          索引
+ * @param  _out            结果
+ */
+void batch(const fdt_index& _index, bringup_t& _out) {
+  constexpr uint8_t ALL =
+      resource_t::MEM | resource_t::INTR_NO | resource_t::FREQUENCY;
+  query_t queries[] = {
+      {query_t::PREFIX, ALL, "memory@", _out.memory, 1},
+      {query_t::PREFIX, ALL, "clint@", _out.clint, 1},
+      {query_t::PREFIX, ALL, "plic@", _out.plic, 1},
+      {query_t::PATH, ALL, "/soc/uart@10000000", _out.uart, 1},
+      {query_t::PREFIX, ALL, "rtc@", _out.rtc, 1},
+      {query_t::COMPATIBLE, ALL, "sifive,test0", _out.test, 1},
+      {query_t::PREFIX, ALL, "flash@", _out.flash, 1},
+      {query_t::PREFIX, ALL, "cpus", _out.cpus, 1},
+      {query_t::COMPATIBLE, ALL, "virtio,mmio", _out.virtio, 8},
+  };
+  _index.find_batch(queries, sizeof(queries) / sizeof(queries[0]));
+}
+
+/**
+ * @brief 手写的属性循环，select() 之前的写法
+ * @param  _index          索引
+ * @return size_t          device_type = "memory" 的节点数
+ */
+size_t memory_loop(const fdt_index& _index) {
+  size_t res = 0;
+  for (size_t i = 0; i < _index.node_count(); i++) {
+    auto& node = _index.node(i);
+    for (size_t j = 0; j < node.prop_count; j++) {
+      if (strcmp(_index.prop_name(node.props[j]), "device_type") == 0 &&
+          strcmp((const char*)_index.prop_addr(node.props[j]), "memory") ==
+              0) {
+        res++;
+      }
+    }
+  }
+  return res;
+}
+
+/**
+ * @brief 输出一种配置的索引大小与初始化耗时
+ * @param  _name           配置名
+ * @param  _validated      validate() 的结果
+ */
+template <class Config>
+void preset(const char* _name,
+            const FDT_PARSER::fdt_validated_t& _validated) {
+  static FDT_PARSER::basic_fdt_parser<Config> parser;
+  auto res = parser.dtb_init(_validated);
+  assert(res);
+  (void)res;
+  printf("%-28s %10zu bytes\n", _name, sizeof(parser));
+  measure("  dtb_init", [&] {
+    escape(&parser);
+    parser.dtb_init(_validated);
+    escape(&parser);
+  });
+  measure("  find_via_prefix(\"memory@\")", [] {
+    resource_t memory;
+    escape(&parser);
+    parser.find_via_prefix("memory@", &memory);
+    sink = memory.mem.addr;
+  });
+}
+
+/**
+ * @brief 比较先解压再 dtb_init() 与边解压边建立索引的耗时
+ * @param  _path           压缩的 dtb
+ */
+void compressed(const std::string& _path) {
+  std::ifstream input(_path, std::ios::binary);
+  static std::vector<uint8_t> packed;
+  packed.assign(std::istreambuf_iterator<char>(input), {});
+  static std::vector<uint8_t> unpacked;
+  unpacked.resize(
+      FDT_PARSER::fdt_decompressor::content_size(packed.data(), packed.size()));
+  static FDT_PARSER::fdt_decompressor decompressor;
+  static FDT_PARSER::fdt_parser parser;
+  printf("%s\n", _path.c_str());
+  auto two_pass = measure("  decompress + dtb_init", [] {
+    decompressor.decompress(packed.data(), packed.size(), unpacked.data(),
+                            unpacked.size());
+    parser.dtb_init((uintptr_t)unpacked.data());
+    escape(&parser);
+  });
+  auto streamed = measure("  load", [] {
+    decompressor.load(parser, packed.data(), packed.size(), unpacked.data(),
+                      unpacked.size());
+    escape(&parser);
+  });
+  assert(parser.node_count() != 0);
+  printf("speedup %.2fx\n", two_pass / streamed);
+}
+
+/**
+ * @brief 比较修改一个属性后 update() 与重新 dtb_init() 的耗时
+ * @param  _addr           dtb 地址
+ * @param  _size           dtb 长度
+ */
+void live_update(uintptr_t _addr, size_t _size) {
+  static std::vector<uint8_t> blob((uint8_t*)_addr, (uint8_t*)_addr + _size);
+  static FDT_PARSER::fdt_parser parser((uintptr_t)blob.data(),
+                                       fdt_index::DT_INIT_HASH);
+  // 翻转 virtio_mmio@10008000 的 interrupts，长度不变
+  static uint32_t virtio = 0;
+  while (strcmp(parser.node_name(parser.node(virtio)),
+                "virtio_mmio@10008000") != 0) {
+    virtio++;
+  }
+  static auto value = (uint8_t*)parser.prop_addr(parser.node(virtio).props[0]);
+  printf("edit one property\n");
+  auto full = measure("  dtb_init", [] {
+    value[3] ^= 1;
+    parser.dtb_init((uintptr_t)blob.data(), fdt_index::DT_INIT_HASH);
+    escape(&parser);
+  });
+  auto incremental = measure("  update", [] {
+    value[3] ^= 1;
+    parser.update((uintptr_t)blob.data(), &virtio, 1);
+    escape(&parser);
+  });
+  printf("speedup %.2fx\n", full / incremental);
+}
+
+}  // namespace
+
+// usage:
+// ./bin/fdt_parser_bench ../test/riscv64_qemu_virt.dtb
+int main(int, char** _argv) {
+  FDT_PARSER::fdt_mmap file(_argv[1]);
+  assert(file.valid());
+  static auto parser = file.parser();
+
+  // 两种方式的结果相同
+  static bringup_t expected, actual;
+  sequential(parser, expected);
+  batch(parser, actual);
+  assert(actual.memory[0].mem.addr == expected.memory[0].mem.addr);
+  assert(actual.uart[0].intr_no == expected.uart[0].intr_no);
+  assert(actual.cpus[0].frequency == expected.cpus[0].frequency);
+  assert(actual.virtio[7].mem.addr == expected.virtio[7].mem.addr);
+
+  printf("%zu nodes, %d rounds\n", parser.node_count(), (int)ROUNDS);
+  auto seq = measure("sequential find_via_*", [] {
+    bringup_t out;
+    sequential(parser, out);
+    sink = out.virtio[7].mem.addr;
+  });
+  auto bat = measure("find_batch", [] {
+    bringup_t out;
+    batch(parser, out);
+    sink = out.virtio[7].mem.addr;
+  });
+  printf("speedup %.2fx\n", seq / bat);
+
+  // 条件查询，device_type = "memory" 使用倒排索引
+  using predicate_t = fdt_index::predicate_t;
+  static fdt_index::plan_t memory_plan, virtio_plan;
+  predicate_t memory[] = {{predicate_t::STRING, "device_type", "memory"}};
+  predicate_t virtio[] = {{predicate_t::PATH, "/soc/*@*"},
+                          {predicate_t::STRING, "compatible", "virtio,mmio"},
+                          {predicate_t::CELL, "interrupts", nullptr, 8}};
+  auto res = fdt_index::compile(memory, 1, memory_plan) &&
+             fdt_index::compile(virtio, 3, virtio_plan);
+  assert(res);
+  auto loop = measure("device_type loop", [] {
+    escape(&parser);
+    sink = memory_loop(parser);
+  });
+  auto sel = measure("select(device_type)", [] {
+    uint32_t out[1];
+    escape(&parser);
+    sink = parser.select(memory_plan, out, 1);
+  });
+  printf("speedup %.2fx\n", loop / sel);
+  measure("select(path, compatible, cell)", [] {
+    uint32_t out[1];
+    escape(&parser);
+    sink = parser.select(virtio_plan, out, 1);
+  });
+
+  // 各预设配置的索引大小与耗时
+  FDT_PARSER::fdt_validated_t validated;
+  res = fdt_index::validate(file.addr(), file.size(), validated);
+  assert(res);
+  (void)res;
+  preset<FDT_PARSER::fdt_tiny_config_t>("fdt_tiny_config_t", validated);
+  preset<FDT_PARSER::fdt_config_t>("fdt_config_t", validated);
+  preset<FDT_PARSER::fdt_large_config_t>("fdt_large_config_t", validated);
+
+  // 压缩的 dtb
+  compressed(std::string(_argv[1]) + ".gz");
+  compressed(std::string(_argv[1]) + ".lz4");
+
+  // 修改后只重新解析包含修改的子树
+  live_update(file.addr(), file.size());
+  return 0;
+}
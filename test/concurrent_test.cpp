@@ -0,0 +1,156 @@
+
+// This file is a part of MRNIU/fdt-parser
+// (https://github.com/MRNIU/fdt-parser).
+//
+// concurrent_test.cpp for MRNIU/fdt-parser.
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fdt_mmap.hpp"
+#include "fdt_parser.hpp"
+
+namespace {
+
+/// 模拟的 hart 数
+constexpr size_t HARTS_COUNT = 8;
+/// 每个 hart 的查询次数
+constexpr size_t ITERATIONS = 2000;
+
+FDT_PARSER::fdt_shared_index shared;
+std::atomic<size_t> started(0);
+
+// 共享索引只能通过检查 ready() 的接口查询
+template <class T, class = void>
+struct has_node_count : std::false_type {};
+template <class T>
+struct has_node_count<
+    T, std::void_t<decltype(std::declval<const T&>().node_count())>>
+    : std::true_type {};
+static_assert(has_node_count<FDT_PARSER::fdt_index>::value);
+static_assert(!has_node_count<FDT_PARSER::fdt_shared_index>::value);
+
+// 从 hart 在启动 hart 构建索引的同时开始查询
+void secondary_hart(size_t _hartid) {
+  started++;
+  // 等待启动 hart 发布索引
+  while (!shared.ready()) {
+    std::this_thread::yield();
+  }
+
+  // 被测函数的返回值先保存再检查，NDEBUG 时同样会执行
+  [[maybe_unused]] bool ok;
+  [[maybe_unused]] size_t count;
+  for (size_t i = 0; i < ITERATIONS; i++) {
+    // 按 hart 错开查询顺序，让二级索引的构建互相竞争
+    if ((i + _hartid) % 2 == 0) {
+      FDT_PARSER::resource_t uart;
+      ok = shared.find_via_path("/soc/uart@10000000", &uart);
+      assert(ok);
+      assert(uart.mem.addr == 0x10000000);
+      assert(uart.intr_no == 0xA);
+      ok = shared.find_via_path("/soc/missing", &uart);
+      assert(!ok);
+    }
+
+    FDT_PARSER::resource_t virtio[8];
+    count = shared.find_via_compatible("virtio,mmio", virtio);
+    assert(count == 8);
+    assert(virtio[0].mem.addr == 0x10008000);
+    assert(virtio[7].intr_no == 1);
+
+    FDT_PARSER::resource_t test[1];
+    count = shared.find_via_compatible("sifive,test0", test);
+    assert(count == 1);
+    assert(test[0].mem.addr == 0x100000);
+
+    // 有 compatible 条件时使用同一个二级索引
+    using predicate_t = FDT_PARSER::fdt_index::predicate_t;
+    predicate_t predicates[] = {
+        {predicate_t::STRING, "compatible", "virtio,mmio"},
+        {predicate_t::CELL, "interrupts", nullptr, 3},
+    };
+    FDT_PARSER::fdt_index::plan_t plan;
+    ok = FDT_PARSER::fdt_index::compile(predicates, 2, plan);
+    assert(ok);
+    FDT_PARSER::resource_t virtio_3;
+    count = shared.select(plan, &virtio_3, 1);
+    assert(count == 1);
+    assert(virtio_3.mem.addr == 0x10003000);
+
+    FDT_PARSER::resource_t cpu_frequency;
+    cpu_frequency.type = FDT_PARSER::resource_t::FREQUENCY;
+    auto view = shared.view();
+    assert(view.valid());
+    count = view->find_via_prefix("cpus", &cpu_frequency);
+    assert(count == 1);
+    assert(cpu_frequency.frequency == 0x989680);
+
+    if (i % 64 == 0) {
+      FDT_PARSER::cpu_topology_t topology;
+      ok = view->get_cpu_topology(topology);
+      assert(ok);
+      assert(topology.find_cpu(0) != nullptr);
+    }
+  }
+}
+
+}  // namespace
+
+// usage:
+// ./bin/fdt_parser_concurrent_test ../test/riscv64_qemu_virt.dtb
+int main(int, char** _argv) {
+  FDT_PARSER::fdt_mmap file(_argv[1]);
+  assert(file.valid());
+
+  assert(!shared.ready());
+  assert(!shared.view().valid());
+
+  // 失败时不发布，之后可以重新构建
+  [[maybe_unused]] bool ok;
+  std::vector<uint8_t> bad_magic((uint8_t*)file.addr(),
+                                 (uint8_t*)file.addr() + file.size());
+  bad_magic[0] = 0;
+  ok = shared.dtb_init((uintptr_t)bad_magic.data());
+  assert(!ok);
+  assert(!shared.ready());
+  assert(!shared.view().valid());
+  FDT_PARSER::resource_t uart;
+  ok = shared.find_via_path("/soc/uart@10000000", &uart);
+  assert(!ok);
+
+  std::vector<std::thread> harts;
+  for (size_t i = 0; i < HARTS_COUNT; i++) {
+    harts.emplace_back(secondary_hart, i);
+  }
+  while (started != HARTS_COUNT) {
+    std::this_thread::yield();
+  }
+
+  // 启动 hart 构建并发布索引
+  ok = shared.dtb_init(file.addr());
+  assert(ok);
+
+  // 发布后其它 hart 正在查询，再次构建被拒绝且索引不变
+  FDT_PARSER::fdt_validated_t validated;
+  ok = FDT_PARSER::fdt_index::validate(file.addr(), file.size(), validated);
+  assert(ok);
+  ok = shared.dtb_init(validated);
+  assert(!ok);
+  ok = shared.dtb_init(file.addr());
+  assert(!ok);
+  assert(shared.ready());
+
+  for (auto& hart : harts) {
+    hart.join();
+  }
+  ok = shared.find_via_path("/soc/uart@10000000", &uart);
+  assert(ok && uart.mem.addr == 0x10000000);
+
+  return 0;
+}
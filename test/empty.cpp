@@ -4,7 +4,9 @@
 // 
 // empty.cpp for MRNIU/fdt-parser.
 
+#include "fdt_decompressor.hpp"
 #include "fdt_parser.hpp"
+#include "fdt_serializer.hpp"
 
 // usage:
 // ./bin/fdt_parser_test ../test/riscv64_qemu_virt.dtb
@@ -4,28 +4,316 @@
 //
 // test.cpp for MRNIU/fdt-parser.
 
-#include <array>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <random>
+#include <string>
 #include <vector>
 
+#include "fdt_decompressor.hpp"
+#include "fdt_mmap.hpp"
 #include "fdt_parser.hpp"
+#include "fdt_serializer.hpp"
+
+// 节点数少于测试用 dtb 的配置
+struct small_config_t : FDT_PARSER::fdt_tiny_config_t {
+  static constexpr const size_t MAX_NODES_COUNT = 16;
+};
+
+// json 语法检查，确认 fdt_serializer 的输出可以被解析
+struct json_checker_t {
+  const std::string& json;
+  size_t pos;
+
+  void skip_space(void) {
+    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' ||
+                                 json[pos] == '\n' || json[pos] == '\r')) {
+      pos++;
+    }
+  }
+
+  bool eat(char _c) {
+    skip_space();
+    if (pos < json.size() && json[pos] == _c) {
+      pos++;
+      return true;
+    }
+    return false;
+  }
+
+  bool string(void) {
+    if (!eat('"')) {
+      return false;
+    }
+    while (pos < json.size() && json[pos] != '"') {
+      if ((uint8_t)json[pos] < 0x20) {
+        return false;
+      }
+      if (json[pos] == '\\') {
+        pos++;
+        if (pos < json.size() && json[pos] == 'u') {
+          for (size_t i = 1; i <= 4; i++) {
+            if (pos + i >= json.size() || !isxdigit((uint8_t)json[pos + i])) {
+              return false;
+            }
+          }
+          pos += 4;
+        } else if (pos >= json.size() ||
+                   strchr("\"\\/bfnrt", json[pos]) == nullptr) {
+          return false;
+        }
+      }
+      pos++;
+    }
+    return pos++ < json.size();
+  }
+
+  bool number(void) {
+    auto begin = pos;
+    if (pos < json.size() && json[pos] == '-') {
+      pos++;
+    }
+    while (pos < json.size() && isdigit((uint8_t)json[pos])) {
+      pos++;
+    }
+    return pos > begin && isdigit((uint8_t)json[pos - 1]);
+  }
+
+  bool literal(const char* _word) {
+    auto len = strlen(_word);
+    if (json.compare(pos, len, _word) != 0) {
+      return false;
+    }
+    pos += len;
+    return true;
+  }
+
+  // 对象与数组，_object 为 true 时每个成员前有名称
+  bool members(char _close, bool _object) {
+    pos++;
+    if (eat(_close)) {
+      return true;
+    }
+    do {
+      if (_object && !(string() && eat(':'))) {
+        return false;
+      }
+      if (!value()) {
+        return false;
+      }
+    } while (eat(','));
+    return eat(_close);
+  }
+
+  bool value(void) {
+    skip_space();
+    if (pos >= json.size()) {
+      return false;
+    }
+    switch (json[pos]) {
+      case '{':
+        return members('}', true);
+      case '[':
+        return members(']', false);
+      case '"':
+        return string();
+      case 't':
+        return literal("true");
+      case 'f':
+        return literal("false");
+      case 'n':
+        return literal("null");
+      default:
+        return number();
+    }
+  }
+
+  bool valid(void) {
+    pos = 0;
+    if (!value()) {
+      return false;
+    }
+    skip_space();
+    return pos == json.size();
+  }
+};
+
+bool json_valid(const std::string& _json) {
+  json_checker_t checker{_json, 0};
+  return checker.valid();
+}
+
+uint32_t be32(const uint8_t* _p) {
+  return (uint32_t)_p[0] << 24 | _p[1] << 16 | _p[2] << 8 | _p[3];
+}
+
+void put32(uint8_t* _p, uint32_t _v) {
+  _p[0] = _v >> 24;
+  _p[1] = _v >> 16;
+  _p[2] = _v >> 8;
+  _p[3] = _v;
+}
+
+// 两个索引的节点与属性相同，只比较 Config 打开的字段
+template <class Config>
+bool same_index(const FDT_PARSER::basic_fdt_parser<Config>& _a,
+                const FDT_PARSER::basic_fdt_parser<Config>& _b) {
+  if (_a.node_count() != _b.node_count()) {
+    return false;
+  }
+  if constexpr (Config::HASHES) {
+    if (_a.node_count() != 0 && _a.root_hash() != _b.root_hash()) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < _a.node_count(); i++) {
+    auto& a = _a.node(i);
+    auto& b = _b.node(i);
+    if (a.off != b.off || a.parent != b.parent || a.phandle != b.phandle ||
+        a.depth != b.depth || a.address_cells != b.address_cells ||
+        a.size_cells != b.size_cells ||
+        a.interrupt_cells != b.interrupt_cells ||
+        a.prop_count != b.prop_count) {
+      return false;
+    }
+    if constexpr (Config::HASHES) {
+      if (a.hash != b.hash) {
+        return false;
+      }
+    }
+    if constexpr (Config::SIBLINGS) {
+      if (a.sibling != b.sibling) {
+        return false;
+      }
+    }
+    if constexpr (Config::INTERRUPT_PARENTS) {
+      if (a.interrupt_parent != b.interrupt_parent) {
+        return false;
+      }
+    }
+    for (size_t j = 0; j < a.prop_count; j++) {
+      if (a.props[j].nameoff != b.props[j].nameoff ||
+          a.props[j].off != b.props[j].off ||
+          a.props[j].len != b.props[j].len) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// 数据区中每个 token 的起始偏移，最后一项为数据区长度
+std::vector<uint32_t> token_offsets(const std::vector<uint8_t>& _blob) {
+  std::vector<uint32_t> res;
+  auto data = _blob.data() + be32(_blob.data() + 8);
+  auto size = be32(_blob.data() + 36);
+  for (uint32_t off = 0; off < size;) {
+    res.push_back(off);
+    auto type = be32(data + off);
+    if (type == 0x1) {
+      off += 4 + (strlen((const char*)data + off + 4) + 4) / 4 * 4;
+    } else if (type == 0x3) {
+      off += 12 + (be32(data + off + 4) + 3) / 4 * 4;
+    } else if (type == 0x9) {
+      break;
+    } else {
+      off += 4;
+    }
+  }
+  res.push_back(size);
+  return res;
+}
+
+/**
+ * 用 _dtb 中随机的 token 序列或 FDT_NOP 随机替换数据区中的 token 序列，
+ * 有时同时移动头信息之后的内容或在字符区末尾追加字符串，每次修改后
+ * update() 与 dtb_init() 的结果相同。替换后格式错误或超出容量时两者都失败，
+ * 此时从 _dtb 重新开始
+ * _updated 为 update() 成功的次数
+ */
+template <class Config>
+bool random_update(const std::vector<uint8_t>& _dtb, uint32_t _seed,
+                   size_t& _updated) {
+  using parser_t = FDT_PARSER::basic_fdt_parser<Config>;
+  static parser_t live;
+  static parser_t fresh;
+  std::mt19937 rng(_seed);
+  auto src = token_offsets(_dtb);
+  auto src_data = _dtb.begin() + be32(_dtb.data() + 8);
+  _updated = 0;
+  for (size_t round = 0; round < 256; round++) {
+    auto blob = _dtb;
+    if (!live.dtb_init((uintptr_t)blob.data(), parser_t::DT_INIT_HASH)) {
+      return false;
+    }
+    for (size_t step = 0; step < 4; step++) {
+      auto tokens = token_offsets(blob);
+      auto begin = rng() % tokens.size();
+      auto end = std::min<size_t>(begin + rng() % 4, tokens.size() - 1);
+      uint32_t off = tokens[begin];
+      uint32_t old_len = tokens[end] - tokens[begin];
+      std::vector<uint8_t> data(4, 0);
+      data[3] = 0x4;
+      if (rng() % 3 != 0) {
+        auto from = rng() % src.size();
+        auto to = std::min<size_t>(from + rng() % 5, src.size() - 1);
+        data.assign(src_data + src[from], src_data + src[to]);
+      }
+      // 新 dtb 放在新的缓冲区中，update() 之前原缓冲区不变
+      auto next = blob;
+      auto pos = next.begin() + be32(next.data() + 8) + off;
+      pos = next.erase(pos, pos + old_len);
+      next.insert(pos, data.begin(), data.end());
+      uint32_t shift = data.size() - old_len;
+      // totalsize、off_dt_strings 与 size_dt_struct
+      for (auto field : {4, 12, 36}) {
+        put32(next.data() + field, be32(next.data() + field) + shift);
+      }
+      if (rng() % 4 == 0) {
+        // totalsize、off_dt_struct、off_dt_strings 与 off_mem_rsvmap
+        uint32_t move = (rng() % 2 + 1) * 8;
+        next.insert(next.begin() + 40, move, 0);
+        for (auto field : {4, 8, 12, 16}) {
+          put32(next.data() + field, be32(next.data() + field) + move);
+        }
+      }
+      if (rng() % 4 == 0) {
+        // totalsize 与 size_dt_strings
+        next.insert(next.end(), {'x', 0});
+        for (auto field : {4, 32}) {
+          put32(next.data() + field, be32(next.data() + field) + 2);
+        }
+      }
+      blob.swap(next);
+      auto updated =
+          live.update((uintptr_t)blob.data(), off, old_len, data.size());
+      auto init =
+          fresh.dtb_init((uintptr_t)blob.data(), parser_t::DT_INIT_HASH);
+      if (updated != init || (updated && !same_index(live, fresh))) {
+        return false;
+      }
+      if (!updated) {
+        break;
+      }
+      _updated++;
+    }
+  }
+  return true;
+}
 
 // usage:
 // ./bin/fdt_parser_test ../test/riscv64_qemu_virt.dtb
 int main(int, char** _argv) {
-  std::ifstream input(_argv[1], std::ios::binary);
-  std::vector<uint8_t> buffer(std::istreambuf_iterator<char>(input), {});
-  assert(buffer.size() == 3810);
+  FDT_PARSER::fdt_mmap file(_argv[1]);
+  assert(file.valid());
+  assert(file.size() == 3810);
 
-  std::array<uint8_t, 3810> fileArray;
-  for (size_t i = 0; i < buffer.size(); i++) {
-    fileArray[i] = buffer[i];
-  }
-
-  auto result = FDT_PARSER::fdt_parser((uintptr_t)fileArray.data());
+  auto result = file.parser();
 
   FDT_PARSER::resource_t resource_mem;
   resource_mem.type = FDT_PARSER::resource_t::MEM;
@@ -54,5 +342,829 @@ int main(int, char** _argv) {
   assert(strcmp(cpu_frequency.name, "cpus") == 0);
   assert(cpu_frequency.frequency == 0x989680);
 
+  // 被测函数的返回值先保存再检查，NDEBUG 时同样会执行
+  [[maybe_unused]] bool ok;
+  [[maybe_unused]] size_t count;
+  [[maybe_unused]] uint64_t hash;
+
+  static FDT_PARSER::cpu_topology_t topology;
+  ok = result.get_cpu_topology(topology);
+  assert(ok);
+  assert(topology.cpu_count == 1);
+  assert(topology.cpus[0].hartid == 0);
+  assert(topology.cpus[0].enabled);
+  assert(topology.cpus[0].phandle == 1);
+  assert(strcmp(topology.cpus[0].isa, "rv64imafdcsu") == 0);
+  assert(topology.cpus[0].isa_ext & (1U << ('f' - 'a')));
+  assert((topology.cpus[0].isa_ext & (1U << ('v' - 'a'))) == 0);
+  assert(topology.cpus[0].cluster == 0);
+  assert(topology.cpus[0].core == 0);
+  assert(topology.find_cpu(0) == &topology.cpus[0]);
+  assert(topology.find_cpu(1) == nullptr);
+  assert(topology.node_count == 1);
+  assert(topology.distance[0][0] == FDT_PARSER::cpu_topology_t::LOCAL_DISTANCE);
+  assert(topology.node_cpus[0][0] == 1);
+
+  // 两个 numa 节点，cpu-map 中有 socket、cluster、core 与 thread
+  std::string numa_path(_argv[1]);
+  numa_path.replace(numa_path.rfind('/') + 1, std::string::npos,
+                    "riscv64_numa.dtb");
+  FDT_PARSER::fdt_mmap numa_file(numa_path.c_str());
+  assert(numa_file.valid());
+  static FDT_PARSER::fdt_parser numa(numa_file.addr());
+  ok = numa.get_cpu_topology(topology);
+  assert(ok);
+  assert(topology.cpu_count == 4);
+  assert(topology.node_count == 2);
+  for (size_t i = 0; i < topology.cpu_count; i++) {
+    assert(topology.cpus[i].hartid == i);
+    assert(topology.cpus[i].phandle == i + 1);
+    assert(topology.cpus[i].numa_node == i / 2);
+    assert(topology.cpus[i].socket == i / 2);
+    assert(topology.cpus[i].cluster == i / 2);
+  }
+  assert(topology.cpus[1].core == 1 && topology.cpus[1].thread == 0);
+  assert(topology.cpus[2].core == 0 && topology.cpus[2].thread == 0);
+  assert(topology.cpus[3].core == 0 && topology.cpus[3].thread == 1);
+  assert(!topology.cpus[3].enabled);
+  // g 为 imafd 的简写
+  assert(topology.cpus[2].isa_ext & (1U << ('d' - 'a')));
+  assert(topology.find_cpu(3) == &topology.cpus[3]);
+  // 超过 255 的距离不能被截断
+  assert(topology.distance[0][1] == 0x118);
+  assert(topology.distance[1][0] == 0x118);
+  assert(topology.distance[1][1] == FDT_PARSER::cpu_topology_t::LOCAL_DISTANCE);
+  assert(topology.distance[0][2] ==
+         FDT_PARSER::cpu_topology_t::REMOTE_DISTANCE);
+  assert(topology.node_cpus[0][0] == 0x3);
+  assert(topology.node_cpus[1][0] == 0xC);
+  // #address-cells 大于 2 时 hart id 超过 64 位，不能只保留低位
+  std::vector<uint8_t> wide_cpus((uint8_t*)numa_file.addr(),
+                                 (uint8_t*)numa_file.addr() + numa_file.size());
+  for (size_t i = 0; i < numa.node_count(); i++) {
+    auto& node = numa.node(i);
+    for (size_t j = 0; j < node.prop_count; j++) {
+      if (strcmp(numa.node_name(node), "cpus") == 0 &&
+          strcmp(numa.prop_name(node.props[j]), "#address-cells") == 0) {
+        wide_cpus[node.props[j].off + 3] = 3;
+      }
+    }
+  }
+  static FDT_PARSER::fdt_parser wide((uintptr_t)wide_cpus.data());
+  ok = wide.get_cpu_topology(topology);
+  assert(!ok);
+
+  // 句柄只保存索引地址
+  auto view = result.view();
+  auto view_copy = view;
+  static_assert(sizeof(view_copy) == sizeof(void*));
+  assert(&*view_copy == &*view);
+  FDT_PARSER::resource_t resource_uart;
+  resource_uart.type = FDT_PARSER::resource_t::MEM;
+  ok = view_copy->find_via_path("/soc/uart@10000000", &resource_uart);
+  assert(ok);
+  assert(resource_uart.mem.addr == 0x10000000);
+  assert(resource_uart.mem.len == 0x100);
+  assert(resource_uart.intr_no == 0xA);
+  FDT_PARSER::resource_t resource_memory;
+  ok = view->find_via_path("/memory", &resource_memory);
+  assert(ok);
+  assert(resource_memory.mem.addr == 0x80000000);
+  ok = view->find_via_path("/soc/missing", &resource_memory);
+  assert(!ok);
+
+  // 批量查询与逐个查询的结果相同
+  using query_t = FDT_PARSER::fdt_index::query_t;
+  FDT_PARSER::resource_t batch_memory[1], batch_plic[1], batch_uart[1];
+  FDT_PARSER::resource_t batch_virtio[4], batch_cpus[1];
+  query_t queries[] = {
+      {query_t::PREFIX, FDT_PARSER::resource_t::MEM, "memory@", batch_memory,
+       1},
+      {query_t::COMPATIBLE, FDT_PARSER::resource_t::MEM, "riscv,plic0",
+       batch_plic, 1},
+      {query_t::PATH,
+       FDT_PARSER::resource_t::MEM | FDT_PARSER::resource_t::INTR_NO,
+       "/soc/uart@10000000", batch_uart, 1},
+      {query_t::COMPATIBLE, FDT_PARSER::resource_t::INTR_NO, "virtio,mmio",
+       batch_virtio, 4},
+      {query_t::PREFIX, FDT_PARSER::resource_t::FREQUENCY, "cpus", batch_cpus,
+       1},
+      {query_t::PATH, FDT_PARSER::resource_t::MEM, "/soc/missing", nullptr, 0},
+  };
+  count = result.find_batch(queries, 6);
+  assert(count == 5);
+  assert(queries[0].count == 1);
+  assert(batch_memory[0].mem.addr == resource_mem.mem.addr);
+  assert(batch_memory[0].mem.len == resource_mem.mem.len);
+  assert(batch_plic[0].mem.addr == 0xC000000);
+  assert(batch_uart[0].mem.addr == resource_uart.mem.addr);
+  assert(batch_uart[0].intr_no == resource_uart.intr_no);
+  // 结果数组放不下时只填充前 capacity 个
+  assert(queries[3].count == 8);
+  assert(batch_virtio[0].intr_no == 8);
+  assert(batch_virtio[0].type == FDT_PARSER::resource_t::INTR_NO);
+  assert(batch_virtio[0].mem.len == 0);
+  assert(batch_cpus[0].frequency == 0x989680);
+  assert(queries[5].count == 0);
+  // compatible 缺少结尾的 '\0' 时不匹配，不读取属性之外的数据
+  std::vector<uint8_t> unterminated((uint8_t*)file.addr(),
+                                    (uint8_t*)file.addr() + file.size());
+  for (size_t i = 0; i < result.node_count(); i++) {
+    auto& node = result.node(i);
+    if (strcmp(result.node_name(node), "uart@10000000") != 0) {
+      continue;
+    }
+    for (size_t j = 0; j < node.prop_count; j++) {
+      if (strcmp(result.prop_name(node.props[j]), "compatible") == 0) {
+        // "ns16550a" 变为 "ns16550ax"，之后是对齐用的 '\0'
+        unterminated[node.props[j].off + node.props[j].len - 1] = 'x';
+      }
+    }
+  }
+  static FDT_PARSER::fdt_parser unterminated_parser(
+      (uintptr_t)unterminated.data());
+  assert(unterminated_parser.node_count() == result.node_count());
+  FDT_PARSER::resource_t unterminated_uart[1];
+  query_t uart_query[] = {{query_t::COMPATIBLE, FDT_PARSER::resource_t::MEM,
+                           "ns16550ax", unterminated_uart, 1}};
+  count = unterminated_parser.find_batch(uart_query, 1);
+  assert(count == 0);
+  count = unterminated_parser.find_via_compatible("ns16550ax",
+                                                  unterminated_uart);
+  assert(count == 0);
+
+  // 条件组合查询，只遍历一次索引
+  using predicate_t = FDT_PARSER::fdt_parser::predicate_t;
+  using plan_t = FDT_PARSER::fdt_parser::plan_t;
+  plan_t plan;
+  uint32_t selected[16];
+  // /soc 下有 unit address 的节点，不包括 poweroff 与 reboot
+  predicate_t soc_devices[] = {{predicate_t::PATH, "/soc/*@*"}};
+  ok = FDT_PARSER::fdt_parser::compile(soc_devices, 1, plan);
+  assert(ok);
+  count = result.select(plan, selected, 16);
+  assert(count == 15);
+  assert(strcmp(result.node_name(result.node(selected[0])),
+                "flash@20000000") == 0);
+  // 省略 unit address 时与 find_via_path() 相同
+  predicate_t uart_path[] = {{predicate_t::PATH, "/s?c/uart"}};
+  ok = FDT_PARSER::fdt_parser::compile(uart_path, 1, plan);
+  assert(ok);
+  FDT_PARSER::resource_t selected_uart;
+  count = result.select(plan, &selected_uart, 1);
+  assert(count == 1);
+  assert(selected_uart.mem.addr == 0x10000000);
+  assert(selected_uart.intr_no == 0xA);
+  // 字符串、cell 与属性存在条件同时满足
+  predicate_t virtio_8[] = {
+      {predicate_t::STRING, "compatible", "virtio,mmio"},
+      {predicate_t::CELL, "interrupts", nullptr, 8},
+      {predicate_t::PATH, "/soc/virtio_mmio@*"},
+  };
+  ok = FDT_PARSER::fdt_parser::compile(virtio_8, 3, plan);
+  assert(ok);
+  assert(plan.props_begin == 1 && plan.compatible == 1);
+  count = result.select(plan, selected, 16);
+  assert(count == 1);
+  assert(strcmp(result.node_name(result.node(selected[0])),
+                "virtio_mmio@10008000") == 0);
+  predicate_t controllers[] = {{predicate_t::HAS_PROP, "interrupt-controller"},
+                               {predicate_t::CELL, "#interrupt-cells",
+                                nullptr, 1}};
+  ok = FDT_PARSER::fdt_parser::compile(controllers, 2, plan);
+  assert(ok);
+  count = result.select(plan, selected, 16);
+  assert(count == 2);
+  assert(strcmp(result.node_name(result.node(selected[1])),
+                "plic@c000000") == 0);
+  // 字符串列表中的任意一项
+  predicate_t syscon[] = {{predicate_t::STRING, "compatible", "syscon"}};
+  ok = FDT_PARSER::fdt_parser::compile(syscon, 1, plan);
+  assert(ok);
+  count = result.select(plan, selected, 16);
+  assert(count == 1);
+  // 常用条件使用倒排索引，不再逐个节点检查
+  predicate_t memory[] = {{predicate_t::STRING, "device_type", "memory"}};
+  ok = FDT_PARSER::fdt_parser::compile(memory, 1, plan);
+  assert(ok);
+  assert(plan.indexes == plan_t::INDEX_MEMORY && plan.count == 0);
+  FDT_PARSER::resource_t selected_memory;
+  count = result.select(plan, &selected_memory, 1);
+  assert(count == 1);
+  assert(selected_memory.mem.addr == resource_mem.mem.addr);
+  predicate_t okay_cpus[] = {{predicate_t::STRING, "status", "okay"},
+                             {predicate_t::PATH, "/cpus/*"}};
+  ok = FDT_PARSER::fdt_parser::compile(okay_cpus, 2, plan);
+  assert(ok);
+  assert(plan.indexes == plan_t::INDEX_OKAY && plan.count == 1);
+  count = result.select(plan, selected, 16);
+  assert(count == 1);
+  assert(result.node_find(result.node(selected[0]), "device_type", "cpu"));
+  assert(result.node_find(result.node(selected[0]), "riscv,isa", nullptr));
+  assert(!result.node_find(result.node(selected[0]), "status", "disabled"));
+  // 不能满足的组合与格式错误
+  predicate_t none[] = {{predicate_t::STRING, "device_type", "memory"},
+                        {predicate_t::PATH, "/soc/*"}};
+  ok = FDT_PARSER::fdt_parser::compile(none, 2, plan);
+  assert(ok);
+  count = result.select(plan, selected, 16);
+  assert(count == 0);
+  predicate_t relative[] = {{predicate_t::PATH, "soc"}};
+  ok = FDT_PARSER::fdt_parser::compile(relative, 1, plan);
+  assert(!ok);
+  predicate_t too_many[plan_t::MAX_STEPS + 1];
+  ok = FDT_PARSER::fdt_parser::compile(too_many, plan_t::MAX_STEPS + 1,
+                                       plan);
+  assert(!ok);
+
+  // 索引按字节复制到其它地址后仍然可用
+  static std::vector<uint8_t> relocated(sizeof(FDT_PARSER::fdt_parser));
+  memcpy(relocated.data(), &result, sizeof(result));
+  memset((void*)&result, 0, sizeof(result));
+  auto moved = (FDT_PARSER::fdt_parser*)relocated.data();
+  FDT_PARSER::resource_t resource_plic_moved;
+  resource_plic_moved.type = FDT_PARSER::resource_t::MEM;
+  moved->find_via_prefix("plic@", &resource_plic_moved);
+  assert(strcmp(resource_plic_moved.name, "riscv,plic0") == 0);
+  assert(resource_plic_moved.mem.addr == 0xC000000);
+  [[maybe_unused]] auto& clint = moved->node(moved->node_count() - 1);
+  assert(strcmp(moved->node_name(clint), "clint@2000000") == 0);
+  assert(strcmp(moved->node_name(moved->node(clint.parent)), "soc") == 0);
+
+  // 子树哈希，相同的 dtb 根哈希相同
+  using FDT_PARSER::fdt_parser;
+  static fdt_parser hashed(file.addr(),
+                           fdt_parser::DT_INIT_HASH);
+  assert(hashed.root_hash() != 0);
+  hash = fdt_parser::blob_hash(file.addr());
+  assert(hash == hashed.root_hash());
+  static std::vector<uint8_t> blob((uint8_t*)file.addr(),
+                                      (uint8_t*)file.addr() + file.size());
+  static fdt_parser same((uintptr_t)blob.data(), fdt_parser::DT_INIT_HASH);
+  assert(same.root_hash() == hashed.root_hash());
+  count = hashed.diff(same, nullptr, nullptr);
+  assert(count == 0);
+
+  // 复用缓存的索引
+  static fdt_parser cached = hashed;
+  ok = cached.rebase((uintptr_t)blob.data());
+  assert(ok);
+  FDT_PARSER::resource_t resource_plic_cached;
+  cached.find_via_prefix("plic@", &resource_plic_cached);
+  assert((uint8_t*)resource_plic_cached.name > blob.data());
+  assert((uint8_t*)resource_plic_cached.name < blob.data() + blob.size());
+
+  // 修改 plic 的 riscv,ndev，并将 poweroff 节点替换为 FDT_NOP
+  // soc 与 cpus 只用于检查
+  [[maybe_unused]] size_t soc = 0, cpus = 0;
+  size_t plic = 0, poweroff = 0;
+  for (size_t i = 0; i < same.node_count(); i++) {
+    auto name = same.node_name(same.node(i));
+    if (strcmp(name, "soc") == 0) {
+      soc = i;
+    } else if (strcmp(name, "cpus") == 0) {
+      cpus = i;
+    } else if (strcmp(name, "plic@c000000") == 0) {
+      plic = i;
+    } else if (strcmp(name, "poweroff") == 0) {
+      poweroff = i;
+    }
+  }
+  for (size_t i = 0; i < same.node(plic).prop_count; i++) {
+    auto& prop = same.node(plic).props[i];
+    if (strcmp(same.prop_name(prop), "riscv,ndev") == 0) {
+      ((uint8_t*)same.prop_addr(prop))[3] = 0x36;
+    }
+  }
+  auto reboot = same.node(poweroff).sibling;
+  for (auto off = same.node(poweroff).off; off < same.node(reboot).off;
+       off += 4) {
+    const uint8_t nop[] = {0x00, 0x00, 0x00, 0x04};
+    memcpy(blob.data() + off, nop, sizeof(nop));
+  }
+  static fdt_parser changed((uintptr_t)blob.data(), fdt_parser::DT_INIT_HASH);
+  assert(changed.node_count() == hashed.node_count() - 1);
+  assert(changed.root_hash() != hashed.root_hash());
+  assert(changed.node(cpus).hash == hashed.node(cpus).hash);
+  assert(changed.node(soc).hash != hashed.node(soc).hash);
+  ok = hashed.rebase((uintptr_t)blob.data());
+  assert(!ok);
+
+  static FDT_PARSER::fdt_index::diff_t diffs[4];
+  static size_t diffs_count = 0;
+  auto collect = [](const FDT_PARSER::fdt_index::diff_t& _diff, void*) {
+    diffs[diffs_count++] = _diff;
+  };
+  count = hashed.diff(changed, collect, nullptr);
+  assert(count == 2);
+  assert(diffs[0].type == FDT_PARSER::fdt_index::diff_t::NODE_REMOVED);
+  assert(strcmp(hashed.node_name(hashed.node(diffs[0].old_node)), "poweroff") ==
+         0);
+  assert(diffs[0].new_node == soc);
+  assert(diffs[1].type == FDT_PARSER::fdt_index::diff_t::PROP_CHANGED);
+  assert(strcmp(hashed.prop_name(*diffs[1].old_prop), "riscv,ndev") == 0);
+  assert(strcmp(changed.node_name(changed.node(diffs[1].new_node)),
+                "plic@c000000") == 0);
+  diffs_count = 0;
+  count = changed.diff(hashed, collect, nullptr);
+  assert(count == 2);
+  assert(diffs[0].type == FDT_PARSER::fdt_index::diff_t::PROP_CHANGED);
+  assert(diffs[1].type == FDT_PARSER::fdt_index::diff_t::NODE_ADDED);
+  assert(diffs[1].new_node == poweroff);
+
+  // 输出为 dts，与 dtc 生成的源码相同
+  using FDT_PARSER::fdt_serializer;
+  auto append = [](const char* _data, size_t _len, void* _ctx) {
+    ((std::string*)_ctx)->append(_data, _len);
+    return true;
+  };
+  std::string dts_path(_argv[1]);
+  dts_path.replace(dts_path.size() - 1, 1, "s");
+  std::ifstream dts_input(dts_path, std::ios::binary);
+  std::string dts_expected(std::istreambuf_iterator<char>(dts_input), {});
+  std::string dts;
+  fdt_serializer dts_serializer(append, &dts);
+  ok = dts_serializer.serialize(file.addr(), fdt_serializer::FORMAT_DTS);
+  assert(ok);
+  assert(dts == dts_expected);
+
+  std::string labeled;
+  fdt_serializer labeled_serializer(append, &labeled,
+                                    fdt_serializer::SERIALIZE_LABELS);
+  ok = labeled_serializer.serialize(file.addr(), fdt_serializer::FORMAT_DTS);
+  assert(ok);
+  assert(labeled.find("\t\tphandle_3: plic@c000000 {\n") != std::string::npos);
+  assert(labeled.find("interrupt-parent = <&phandle_3>;") != std::string::npos);
+  assert(labeled.find("regmap = <&phandle_4>;") != std::string::npos);
+  assert(labeled.find("\"sifive,test1\", \"sifive,test0\", \"syscon\"") !=
+         std::string::npos);
+
+  std::string json;
+  fdt_serializer json_serializer(append, &json);
+  ok = json_serializer.serialize(file.addr(), fdt_serializer::FORMAT_JSON);
+  assert(ok);
+  assert(json.compare(0, 2, "{\n") == 0);
+  assert(json.find("\"compatible\": \"riscv-virtio\"") != std::string::npos);
+  assert(json.find("\"#address-cells\": [2]") != std::string::npos);
+  assert(json.find("\"interrupt-controller\": true") != std::string::npos);
+  assert(json.find("\"cpus\": {") != std::string::npos);
+
+  assert(json_valid(json));
+
+  // 有保留区时 json 中保留区与根节点的属性之间有 ','
+  std::vector<uint8_t> reserved((uint8_t*)file.addr(),
+                                (uint8_t*)file.addr() + file.size());
+  const uint8_t reserve_entry[16] = {0x00, 0x00, 0x00, 0x00, 0x80, 0x00,
+                                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                     0x00, 0x20, 0x00, 0x00};
+  reserved.insert(reserved.begin() + be32(reserved.data() + 16),
+                  reserve_entry, reserve_entry + sizeof(reserve_entry));
+  // totalsize、off_dt_struct 与 off_dt_strings
+  for (auto field : {4, 8, 12}) {
+    put32(reserved.data() + field,
+          be32(reserved.data() + field) + sizeof(reserve_entry));
+  }
+  std::string reserved_json;
+  fdt_serializer reserved_serializer(append, &reserved_json);
+  ok = reserved_serializer.serialize((uintptr_t)reserved.data(),
+                                     fdt_serializer::FORMAT_JSON);
+  assert(ok);
+  assert(json_valid(reserved_json));
+  assert(reserved_json.find("\"/memreserve/\": [\n    [2147483648, 2097152]\n"
+                            "  ],\n  \"#address-cells\": [2],") !=
+         std::string::npos);
+  std::string reserved_dts;
+  fdt_serializer reserved_dts_serializer(append, &reserved_dts);
+  ok = reserved_dts_serializer.serialize((uintptr_t)reserved.data(),
+                                         fdt_serializer::FORMAT_DTS);
+  assert(ok);
+  assert(reserved_dts.find("/memreserve/\t0x0000000080000000 "
+                           "0x0000000000200000;\n\n/ {\n") ==
+         sizeof("/dts-v1/;\n\n") - 1);
+  // 格式错误的 json 不能通过检查
+  assert(!json_valid("{\"a\": [1] \"b\": 2}"));
+
+  // sink 失败时停止输出
+  auto reject = [](const char*, size_t, void*) { return false; };
+  fdt_serializer rejected(reject, nullptr);
+  ok = rejected.serialize(file.addr(), fdt_serializer::FORMAT_DTS);
+  assert(!ok);
+
+  // 检查 dtb 结构，通过后不再检查边界
+  using FDT_PARSER::fdt_validated_t;
+  fdt_validated_t validated;
+  assert(!validated.valid());
+  ok = fdt_parser::validate(file.addr(), file.size(), validated);
+  assert(ok);
+  assert(validated.valid() && validated.fits_index());
+  assert(validated.dtb_size() == 3810);
+  static fdt_parser trusted(validated, fdt_parser::DT_INIT_HASH);
+  assert(trusted.node_count() == hashed.node_count());
+  hash = fdt_parser::blob_hash(validated);
+  assert(hash == hashed.root_hash());
+  std::string trusted_dts;
+  fdt_serializer trusted_serializer(append, &trusted_dts);
+  ok = trusted_serializer.serialize(validated, fdt_serializer::FORMAT_DTS);
+  assert(ok);
+  assert(trusted_dts == dts_expected);
+
+  // 长度不足、属性名越界、token 错误与嵌套不匹配都不能通过
+  ok = fdt_parser::validate(file.addr(), file.size() - 1, validated);
+  assert(!ok);
+  auto struct_off = be32((const uint8_t*)file.addr() + 8);
+  auto struct_size = be32((const uint8_t*)file.addr() + 36);
+  // 根节点名占 1 个 word，之后是第一个属性
+  const size_t corrupt_offsets[] = {struct_off + 16,
+                                    struct_off + struct_size - 4,
+                                    struct_off + struct_size - 8};
+  for (auto off : corrupt_offsets) {
+    std::vector<uint8_t> corrupt((uint8_t*)file.addr(),
+                                 (uint8_t*)file.addr() + file.size());
+    corrupt[off] = 0x7F;
+    ok = fdt_parser::validate((uintptr_t)corrupt.data(), corrupt.size(),
+                              validated);
+    assert(!ok);
+    static fdt_parser rejected_parser;
+    ok = rejected_parser.dtb_init((uintptr_t)corrupt.data());
+    assert(!ok);
+    assert(rejected_parser.node_count() == 0);
+    hash = fdt_parser::blob_hash((uintptr_t)corrupt.data());
+    assert(hash == 0);
+  }
+
+  // 按配置裁剪的索引与完整索引的结果相同
+  using tiny_parser =
+      FDT_PARSER::basic_fdt_parser<FDT_PARSER::fdt_tiny_config_t>;
+  ok = fdt_parser::validate(file.addr(), file.size(), validated);
+  assert(ok);
+  assert(validated.fits<FDT_PARSER::fdt_tiny_config_t>());
+  static tiny_parser tiny(validated);
+  static_assert(sizeof(tiny) < sizeof(fdt_parser) / 4);
+  assert(tiny.node_count() == hashed.node_count());
+  FDT_PARSER::resource_t tiny_uart;
+  ok = tiny.find_via_path("/soc/uart@10000000", &tiny_uart);
+  assert(ok);
+  assert(tiny_uart.type == FDT_PARSER::resource_t::MEM);
+  assert(tiny_uart.mem.addr == 0x10000000);
+  assert(tiny_uart.intr_no == 0);
+  // 没有倒排索引时逐个节点检查，结果相同
+  tiny_parser::plan_t tiny_plan;
+  tiny_parser::predicate_t tiny_memory[] = {
+      {tiny_parser::predicate_t::STRING, "device_type", "memory"}};
+  ok = tiny_parser::compile(tiny_memory, 1, tiny_plan);
+  assert(ok);
+  assert(tiny_plan.indexes == 0 && tiny_plan.count == 1);
+  uint32_t tiny_selected[1];
+  count = tiny.select(tiny_plan, tiny_selected, 1);
+  assert(count == 1);
+  assert(strcmp(tiny.node_name(tiny.node(tiny_selected[0])),
+                "memory@80000000") == 0);
+  using large_parser =
+      FDT_PARSER::basic_fdt_parser<FDT_PARSER::fdt_large_config_t>;
+  static large_parser large(validated, fdt_parser::DT_INIT_HASH);
+  assert(large.root_hash() == hashed.root_hash());
+  assert(large.node(large.node_count() - 1).interrupt_parent ==
+         hashed.node(hashed.node_count() - 1).interrupt_parent);
+  // 超出容量时不建立索引
+  assert(!validated.fits<small_config_t>());
+  static FDT_PARSER::basic_fdt_parser<small_config_t> small(validated);
+  assert(small.node_count() == 0);
+
+  // 压缩的 dtb，边解压边建立索引，结果与解压后 dtb_init() 相同
+  using FDT_PARSER::fdt_decompressor;
+  // gzip 中分别是动态 huffman、不压缩的块，以及固定 huffman 与 sync flush
+  // 插入的空的不压缩块；lz4 中分别是相互独立的块，以及引用前面的块的数据
+  // 且第 3 块不压缩的块
+  const char* suffixes[] = {".gz", ".stored.gz", ".fixed.gz", ".lz4",
+                            ".linked.lz4"};
+  [[maybe_unused]] const fdt_decompressor::format_t formats[] = {
+      fdt_decompressor::FORMAT_GZIP, fdt_decompressor::FORMAT_GZIP,
+      fdt_decompressor::FORMAT_GZIP, fdt_decompressor::FORMAT_LZ4,
+      fdt_decompressor::FORMAT_LZ4};
+  for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+    std::ifstream packed_input(std::string(_argv[1]) + suffixes[i],
+                               std::ios::binary);
+    std::vector<uint8_t> packed(std::istreambuf_iterator<char>(packed_input),
+                                {});
+    [[maybe_unused]] auto format =
+        fdt_decompressor::detect(packed.data(), packed.size());
+    assert(format == formats[i]);
+    count = fdt_decompressor::content_size(packed.data(), packed.size());
+    assert(count == file.size());
+    static fdt_decompressor decompressor;
+    std::vector<uint8_t> unpacked(file.size());
+    [[maybe_unused]] auto status = decompressor.decompress(
+        packed.data(), packed.size(), unpacked.data(), unpacked.size());
+    assert(status == fdt_decompressor::STATUS_OK);
+    assert(decompressor.size() == file.size());
+    assert(memcmp(unpacked.data(), (void*)file.addr(), file.size()) == 0);
+    static fdt_parser loaded;
+    status = decompressor.load(loaded, packed.data(), packed.size(),
+                               unpacked.data(), unpacked.size(),
+                               fdt_parser::DT_INIT_HASH);
+    assert(status == fdt_decompressor::STATUS_OK);
+    static fdt_parser expected_index;
+    ok = expected_index.dtb_init((uintptr_t)unpacked.data(),
+                                 fdt_parser::DT_INIT_HASH);
+    assert(ok);
+    assert(same_index(loaded, expected_index));
+    FDT_PARSER::resource_t loaded_uart;
+    ok = loaded.find_via_path("/soc/uart@10000000", &loaded_uart);
+    assert(ok);
+    assert(loaded_uart.mem.addr == 0x10000000 && loaded_uart.intr_no == 0xA);
+
+    // 损坏或不完整的输入与容量不足都不能通过，且不留下部分索引
+    auto corrupt = packed;
+    corrupt[corrupt.size() / 2] ^= 0x10;
+    status = decompressor.load(loaded, corrupt.data(), corrupt.size(),
+                               unpacked.data(), unpacked.size());
+    assert(status != fdt_decompressor::STATUS_OK);
+    assert(loaded.node_count() == 0);
+    status = decompressor.decompress(packed.data(), packed.size() - 4,
+                                     unpacked.data(), unpacked.size());
+    assert(status != fdt_decompressor::STATUS_OK);
+    status = decompressor.decompress(packed.data(), packed.size(),
+                                     unpacked.data(), unpacked.size() - 1);
+    assert(status == fdt_decompressor::STATUS_NO_SPACE);
+  }
+
+  // 每次只多提供一个字节，结果与一次提供全部相同
+  static fdt_parser streamed;
+  fdt_parser::stream_t stream;
+  streamed.stream_begin(stream, file.addr(), file.size());
+  for (size_t avail = 0; avail <= file.size(); avail++) {
+    ok = streamed.stream_feed(stream, avail);
+    assert(ok);
+  }
+  ok = streamed.stream_finish(stream, fdt_parser::DT_INIT_HASH);
+  assert(ok);
+  assert(same_index(streamed, hashed));
+  // 数据区错误在数据到达时就被发现
+  std::vector<uint8_t> bad_token((uint8_t*)file.addr(),
+                                 (uint8_t*)file.addr() + file.size());
+  bad_token[struct_off + 16] = 0x7F;
+  streamed.stream_begin(stream, (uintptr_t)bad_token.data(), bad_token.size());
+  ok = streamed.stream_feed(stream, struct_off + 20);
+  assert(!ok);
+  ok = streamed.stream_finish(stream);
+  assert(!ok);
+  assert(streamed.node_count() == 0);
+  // 未压缩的 dtb 边复制边建立索引，发现错误时中止，之前的索引被清空
+  static fdt_decompressor raw_decompressor;
+  std::vector<uint8_t> raw_copy(file.size());
+  [[maybe_unused]] auto raw_status = raw_decompressor.load(
+      streamed, (const void*)file.addr(), file.size(), raw_copy.data(),
+      raw_copy.size(), fdt_parser::DT_INIT_HASH);
+  assert(raw_status == fdt_decompressor::STATUS_OK);
+  assert(same_index(streamed, hashed));
+  raw_status = raw_decompressor.load(streamed, bad_token.data(),
+                                     bad_token.size(), raw_copy.data(),
+                                     raw_copy.size());
+  assert(raw_status == fdt_decompressor::STATUS_BAD_DTB);
+  assert(streamed.node_count() == 0);
+  FDT_PARSER::resource_t aborted_uart;
+  ok = streamed.find_via_path("/soc/uart@10000000", &aborted_uart);
+  assert(!ok);
+
+  // 修改数据区后只重新解析包含修改的子树，结果与 dtb_init() 相同
+  // 替换数据区中的 [_off, _off + _old_len)，之后的字符区随之移动
+  auto splice = [&](std::vector<uint8_t>& _blob, uint32_t _off,
+                    uint32_t _old_len, const std::vector<uint8_t>& _data) {
+    auto pos = _blob.begin() + be32(_blob.data() + 8) + _off;
+    pos = _blob.erase(pos, pos + _old_len);
+    _blob.insert(pos, _data.begin(), _data.end());
+    uint32_t shift = _data.size() - _old_len;
+    // totalsize、off_dt_strings 与 size_dt_struct
+    for (auto field : {4, 12, 36}) {
+      put32(_blob.data() + field, be32(_blob.data() + field) + shift);
+    }
+  };
+  // 属性名在字符区中的偏移，没有时追加到字符区末尾
+  auto nameoff = [&](std::vector<uint8_t>& _blob, const char* _name) {
+    auto str = be32(_blob.data() + 12);
+    auto str_size = be32(_blob.data() + 32);
+    for (uint32_t off = 0; off < str_size;) {
+      auto name = (const char*)_blob.data() + str + off;
+      if (strcmp(name, _name) == 0) {
+        return off;
+      }
+      off += strlen(name) + 1;
+    }
+    _blob.insert(_blob.begin() + str + str_size, _name,
+                 _name + strlen(_name) + 1);
+    put32(_blob.data() + 4, be32(_blob.data() + 4) + strlen(_name) + 1);
+    put32(_blob.data() + 32, str_size + strlen(_name) + 1);
+    return str_size;
+  };
+  auto token = [&](uint32_t _type, const void* _data, uint32_t _len) {
+    std::vector<uint8_t> res(4 + (_len + 3) / 4 * 4);
+    put32(res.data(), _type);
+    if (_len != 0) {
+      memcpy(res.data() + 4, _data, _len);
+    }
+    return res;
+  };
+  auto prop_token = [&](uint32_t _nameoff, const void* _data, uint32_t _len) {
+    uint8_t head[8];
+    put32(head, _len);
+    put32(head + 4, _nameoff);
+    auto res = token(0x3, head, sizeof(head));
+    res.resize(res.size() + (_len + 3) / 4 * 4);
+    if (_len != 0) {
+      memcpy(res.data() + 12, _data, _len);
+    }
+    return res;
+  };
+  // 节点名指向索引所在的 dtb，只在 update() 之后、修改 live_blob 之前查找
+  auto node_index = [](const fdt_parser& _parser, const char* _name) {
+    for (uint32_t i = 0;; i++) {
+      if (strcmp(_parser.node_name(_parser.node(i)), _name) == 0) {
+        return i;
+      }
+    }
+  };
+  static std::vector<uint8_t> live_blob((uint8_t*)file.addr(),
+                                        (uint8_t*)file.addr() + file.size());
+  static fdt_parser live((uintptr_t)live_blob.data(),
+                         fdt_parser::DT_INIT_HASH);
+  static fdt_parser fresh;
+  predicate_t okay[] = {{predicate_t::STRING, "status", "okay"}};
+  plan_t okay_plan;
+  ok = fdt_parser::compile(okay, 1, okay_plan);
+  assert(ok);
+  auto same_as_init = [&]() {
+    auto init =
+        fresh.dtb_init((uintptr_t)live_blob.data(), fdt_parser::DT_INIT_HASH);
+    uint32_t live_okay[4], fresh_okay[4];
+    auto count = live.select(okay_plan, live_okay, 4);
+    return init && same_index(live, fresh) &&
+           count == fresh.select(okay_plan, fresh_okay, 4) &&
+           memcmp(live_okay, fresh_okay, count * sizeof(uint32_t)) == 0;
+  };
+  auto live_off = [&](uint32_t _off) {
+    return _off - be32(live_blob.data() + 8);
+  };
+  // 在设备的第一个属性之前加入 status，再将其改为更长的值
+  auto virtio = node_index(live, "virtio_mmio@10008000");
+  auto off = live_off(live.node(virtio).props[0].off - 12);
+  auto status =
+      prop_token(nameoff(live_blob, "status"), "okay", sizeof("okay"));
+  splice(live_blob, off, 0, status);
+  ok = live.update((uintptr_t)live_blob.data(), off, 0, status.size());
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  [[maybe_unused]] uint32_t okay_nodes[4];
+  count = live.select(okay_plan, okay_nodes, 4);
+  assert(count == 2 && okay_nodes[1] == virtio);
+  status = prop_token(nameoff(live_blob, "status"), "disabled",
+                      sizeof("disabled"));
+  splice(live_blob, off, 12 + 8, status);
+  ok = live.update((uintptr_t)live_blob.data(), &virtio, 1);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  count = live.select(okay_plan, okay_nodes, 4);
+  assert(count == 1);
+  // 长度不变的修改
+  auto uart = node_index(live, "uart@10000000");
+  live_blob[live.node(uart).props[0].off + 3] = 0x0C;
+  ok = live.update((uintptr_t)live_blob.data(), &uart, 1);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  FDT_PARSER::resource_t live_uart;
+  ok = live.find_via_path("/soc/uart@10000000", &live_uart);
+  assert(ok);
+  assert(live_uart.intr_no == 0xC);
+  // 加入新节点，之后节点的下标、父节点、兄弟节点、phandle 与中断父节点都移动
+  // nameoff() 可能在字符区追加属性名，先取得下标
+  auto core0 = node_index(live, "core0");
+  [[maybe_unused]] auto live_plic = node_index(live, "plic@c000000");
+  off = live_off(live.node(core0).props[0].off + 4 + 4);
+  const uint8_t cpu[] = {0x00, 0x00, 0x00, 0x01};
+  auto core1 = token(0x1, "core1", sizeof("core1"));
+  for (auto& part :
+       {prop_token(nameoff(live_blob, "cpu"), cpu, sizeof(cpu)),
+        prop_token(nameoff(live_blob, "linux,hotplugged"), nullptr, 0),
+        token(0x2, nullptr, 0)}) {
+    core1.insert(core1.end(), part.begin(), part.end());
+  }
+  splice(live_blob, off, 0, core1);
+  ok = live.update((uintptr_t)live_blob.data(), off, 0, core1.size());
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  assert(node_index(live, "plic@c000000") == live_plic + 1);
+  assert(live.node(node_index(live, "rtc@101000")).interrupt_parent ==
+         live_plic + 1);
+  // 删除带有 phandle 的节点
+  auto test = node_index(live, "test@100000");
+  off = live_off(live.node(test).off);
+  auto len = live.node(test + 1).off - live.node(test).off;
+  splice(live_blob, off, len, {});
+  ok = live.update((uintptr_t)live_blob.data(), off, len, 0);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  assert(live.node_count() == hashed.node_count());
+  // 只删除 phandle 属性，节点数不变
+  auto cpu0 = node_index(live, "cpu@0");
+  assert(strcmp(live.prop_name(live.node(cpu0).props[0]), "phandle") == 0);
+  off = live_off(live.node(cpu0).props[0].off - 12);
+  splice(live_blob, off, 12 + 4, {});
+  ok = live.update((uintptr_t)live_blob.data(), &cpu0, 1);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  assert(live.node(cpu0).phandle == 0);
+  // 删除最后一个子节点
+  auto live_clint = node_index(live, "clint@2000000");
+  off = live_off(live.node(live_clint).off);
+  len = be32(live_blob.data() + 8) + be32(live_blob.data() + 36) -
+        live.node(live_clint).off - 4 * 3;
+  splice(live_blob, off, len, {});
+  ok = live.update((uintptr_t)live_blob.data(), off, len, 0);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  assert(live.node(node_index(live, "plic@c000000")).sibling ==
+         fdt_parser::NO_NODE);
+  // 只有头信息与保留区移动
+  live_blob.insert(live_blob.begin() + 40, 16, 0);
+  for (auto field : {4, 8, 12, 16}) {
+    put32(live_blob.data() + field, be32(live_blob.data() + field) + 16);
+  }
+  ok = live.update((uintptr_t)live_blob.data(), nullptr, 0);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  // 每个节点中加入 FDT_NOP，包括需要重新建立全部索引的根节点
+  for (uint32_t i = 0; i < live.node_count(); i++) {
+    auto name_len = strlen(live.node_name(live.node(i))) + 1;
+    off = live_off(live.node(i).off + 4 + (name_len + 3) / 4 * 4);
+    splice(live_blob, off, 0, token(0x4, nullptr, 0));
+    ok = live.update((uintptr_t)live_blob.data(), off, 0, 4);
+    assert(ok);
+    ok = same_as_init();
+    assert(ok);
+  }
+  // 替换的子树中 phandle 多于 MAX_UPDATE_PHANDLES 时重新建立全部索引
+  for (uint32_t i = 0; i < live.node_count(); i++) {
+    if (strncmp(live.node_name(live.node(i)), "virtio_mmio@", 12) != 0) {
+      continue;
+    }
+    off = live_off(live.node(i).props[0].off - 12);
+    uint8_t phandle[4];
+    put32(phandle, 0x100 + i);
+    splice(live_blob, off, 0,
+           prop_token(nameoff(live_blob, "phandle"), phandle, 4));
+    ok = live.update((uintptr_t)live_blob.data(), &i, 1);
+    assert(ok);
+    ok = same_as_init();
+    assert(ok);
+  }
+  auto live_soc = node_index(live, "soc");
+  [[maybe_unused]] size_t soc_phandles = 0;
+  auto soc_depth = live.node(live_soc).depth;
+  for (auto i = live_soc + 1;
+       i < live.node_count() && live.node(i).depth > soc_depth; i++) {
+    soc_phandles += live.node(i).phandle != 0;
+  }
+  assert(soc_phandles > fdt_parser::MAX_UPDATE_PHANDLES);
+  off = live_off(live.node(live_soc).props[0].off - 12);
+  splice(live_blob, off, 0, token(0x4, nullptr, 0));
+  ok = live.update((uintptr_t)live_blob.data(), &live_soc, 1);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  // 与新 dtb 不符的范围重新建立全部索引
+  splice(live_blob, 0, 0, token(0x4, nullptr, 0));
+  ok = live.update((uintptr_t)live_blob.data(), 0, 0, 8);
+  assert(ok);
+  ok = same_as_init();
+  assert(ok);
+  // 随机修改，包括格式错误与超出容量，裁剪的配置只比较存在的字段
+  const std::vector<uint8_t> virt_blob((uint8_t*)file.addr(),
+                                       (uint8_t*)file.addr() + file.size());
+  ok = random_update<FDT_PARSER::fdt_config_t>(virt_blob, 1, count);
+  assert(ok && count > 0);
+  ok = random_update<FDT_PARSER::fdt_tiny_config_t>(virt_blob, 2, count);
+  assert(ok && count > 0);
+  ok = random_update<FDT_PARSER::fdt_large_config_t>(virt_blob, 3, count);
+  assert(ok && count > 0);
+
+  // 文件不完整时拒绝映射
+  FDT_PARSER::fdt_mmap missing_file("/nonexistent.dtb");
+  assert(missing_file.status() == FDT_PARSER::fdt_mmap::STATUS_OPEN_FAILED);
+  const char* truncated_path = "truncated.dtb";
+  std::ofstream truncated(truncated_path, std::ios::binary);
+  truncated.write((const char*)file.addr(), 1024);
+  truncated.close();
+  FDT_PARSER::fdt_mmap truncated_file(truncated_path);
+  assert(truncated_file.status() == FDT_PARSER::fdt_mmap::STATUS_BAD_HEADER);
+  assert(truncated_file.addr() == 0);
+  std::remove(truncated_path);
+
   return 0;
 }